@@ -0,0 +1,88 @@
+#include "animlod.h"
+#include <algorithm>
+
+static const int Interval[] = { 1, 2, 4, 0 };
+static const float Cost[] = { 1.f, .5f, .25f, 0.f };
+
+int AnimScheduler::Add(vec3 center, float radius)
+{
+    AnimCharacter c;
+    c.center = center;
+    c.radius = radius;
+    c.phase = _characters.size();
+    c.lod = LodFull;
+    c.screenSize = 0;
+    c.valid = false;
+    c.lastUpdate = 0;
+    _characters.push_back(c);
+    return _characters.size()-1;
+}
+
+void AnimScheduler::Schedule(vec3 ro, vec3 ta, float fov, vec2 res, uint32_t iFrame, vector<int> & update)
+{
+    vec3 cw = normalize(ta-ro);
+    vec3 cu = normalize(cross(cw, vec3(0,1,0)));
+    vec3 cv = cross(cu, cw);
+    float ar = res.x / res.y;
+    float lx = sqrt(fov*fov + ar*ar), ly = sqrt(fov*fov + 1.f);
+
+    vector<int> order;
+    for (size_t i=0; i<_characters.size(); i++)
+    {
+        AnimCharacter & c = _characters[i];
+        vec3 d = c.center - ro;
+        float x = dot(d, cu), y = dot(d, cv), z = dot(d, cw);
+
+        // bounding sphere against the side planes of the view frustum
+        bool visible = z > -c.radius
+                && (fov*abs(x) - ar*z) / lx < c.radius
+                && (fov*abs(y) - z) / ly < c.radius;
+        c.screenSize = !visible ? 0.f : z > c.radius ? c.radius * fov / z : 1.f;
+        order.push_back(i);
+    }
+
+    // the largest characters claim the budget first
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return _characters[a].screenSize > _characters[b].screenSize;
+    });
+
+    float used = 0;
+    for (int i : order)
+    {
+        AnimCharacter & c = _characters[i];
+        int lod = c.screenSize >= halfSize ? LodFull
+                : c.screenSize >= quarterSize ? LodHalf
+                : c.screenSize >= freezeSize ? LodQuarter : LodFrozen;
+        while (lod < LodFrozen && used + Cost[lod] > budget) lod++;
+        used += Cost[lod];
+        c.lod = (AnimLod)lod;
+
+        // staggered by phase, so characters sharing a rate spread over frames
+        if (!c.valid || (lod != LodFrozen && (iFrame + c.phase) % Interval[lod] == 0))
+        {
+            update.push_back(i);
+        }
+    }
+}
+
+void AnimScheduler::Commit(int i, uint32_t iFrame, Pose const& pose)
+{
+    AnimCharacter & c = _characters[i];
+    c.prev = c.valid ? c.next : pose;
+    c.next = pose;
+    c.lastUpdate = iFrame;
+    c.valid = true;
+}
+
+void AnimScheduler::Sample(int i, uint32_t iFrame, Pose *out) const
+{
+    AnimCharacter const& c = _characters[i];
+    int interval = Interval[c.lod];
+    *out = c.next;
+    if (interval > 1)
+    {
+        float alpha = min(1.f, (iFrame - c.lastUpdate + 1.f) / interval);
+        *out = c.prev;
+        LerpPose(out, c.next, alpha);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef ANIMLOD_H
+#define ANIMLOD_H
+#include "blend.h"
+
+typedef enum {
+    LodFull,
+    LodHalf,
+    LodQuarter,
+    LodFrozen,
+}AnimLod;
+
+typedef struct {
+    vec3 center;
+    float radius;
+    int phase;
+    AnimLod lod;
+    float screenSize;   // projected diameter over screen height
+    bool valid;         // 'next' holds an evaluated pose
+    uint32_t lastUpdate;
+    Pose prev, next;
+}AnimCharacter;
+
+/// decides which characters evaluate their animation this frame
+struct AnimScheduler
+{
+    float budget = 8.f; // full rate evaluations per frame
+    float halfSize = .25f;
+    float quarterSize = .1f;
+    float freezeSize = .02f;
+    vector<AnimCharacter> _characters;
+
+    int Add(vec3 center, float radius);
+
+    void Schedule(vec3 ro, vec3 ta, float fov, vec2 res, uint32_t iFrame, vector<int> & update);
+
+    /// store a freshly evaluated pose
+    void Commit(int i, uint32_t iFrame, Pose const& pose);
+
+    /// pose to display, interpolated between the last two evaluations
+    void Sample(int i, uint32_t iFrame, Pose *out) const;
+};
+
+#endif // ANIMLOD_H
@@ -0,0 +1,28 @@
+#version 300 es
+precision mediump float;
+
+#ifdef _COARSE
+// the scene distance at every brick center, x by (y, z) rows
+out vec4 fragColor;
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec3 brick = ivec3(p.x, p.y % BrickGrid.y, p.y / BrickGrid.y);
+    highp vec3 pos = AtlasMin + (vec3(brick) + .5)*BrickSize;
+    fragColor = vec4(mapScene(pos).x);
+}
+#else
+// one slice of the atlas, only the texels of slots flagged for baking
+uniform highp sampler3D iChannel0;
+uniform int iLayer;
+out vec4 fragColor;
+void main()
+{
+    ivec3 texel = ivec3(ivec2(gl_FragCoord.xy), iLayer);
+    vec4 owner = texelFetch(iChannel0, texel / BrickTexels, 0);
+    if (owner.w == 0.) discard;
+
+    highp vec3 pos = owner.xyz + vec3(texel % BrickTexels) / float(BrickTexels-1) * BrickSize;
+    fragColor = vec4(mapScene(pos), 0, 0);
+}
+#endif
@@ -1,12 +1,13 @@
 #version 300 es
 precision mediump float;
-precision mediump sampler2DArray;
-precision mediump sampler2DShadow;
+precision mediump sampler2DArrayShadow;
 
 layout (std140) uniform INPUT {
     vec2 iResolution; float iTime, _pad1;
     vec3 _ro; float _fov;
     vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
 };
 
 mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
@@ -30,40 +31,6 @@ vec3 palette( in float t, in vec3 a, in vec3 b, in vec3 c, in vec3 d )
     return a + b*cos( 6.28318*(c*t+d) );
 }
 
-float sdBox(vec3 pos, float b)
-{
-    vec3 q = abs(pos) - b;
-    return length(max(q, 0.0));
-}
-
-float sdTorus( vec3 p, vec2 t )
-{
-  vec2 q = vec2(length(p.xz)-t.x,p.y);
-  return length(q)-t.y;
-}
-
-// https://iquilezles.org/articles/smin
-float smin( float a, float b, float k )
-{
-    float h = max(k-abs(a-b),0.0);
-    return min(a, b) - h*h*0.25/k;
-}
-
-//============================================================//
-
-vec2 map(vec3 pos)
-{
-    float d1, d2;
-    d1 = pos.y + .05;
-    float id = 1.;
-//    d2 = length(pos-vec3(0,1,0)) - .1;
-//    if (d2 < d1) { d1=d2; id=1.; }
-//    d2 = sdBox(pos-vec3(-.2,1,0), .3) - .02;
-//    d1 = smin(d1,d2,.2);
-
-    return vec2(d1, id);
-}
-
 vec3 calcNormal(vec3 pos)
 {
     vec2 e = vec2(1.0,-1.0)*0.5773*0.001;
@@ -73,70 +40,223 @@ vec3 calcNormal(vec3 pos)
                      e.xxx*map( pos + e.xxx ).x );
 }
 
-vec4 World2Clip(vec3 pos, vec3 rd)
+layout (std140) uniform SHADOW {
+    mat4 iCascade[4];   // world to light clip space, per cascade
+    vec4 iSplits;       // far end of every cascade along the view axis
+};
+
+// _SHADOW_FILTER picks the kernel: 0 a 5x5 box, 1 a 5x5 tent out of 9
+// bilinear taps, 2 a rotated poisson disk; with _SHADOW_EARLY_OUT four wide
+// probes that agree skip the kernel
+#ifndef _SHADOW_FILTER
+#define _SHADOW_FILTER 0
+#endif
+
+const vec2 Poisson[12] = vec2[12](
+    vec2(-0.326212,-0.405810), vec2(-0.840144,-0.073580), vec2(-0.695914, 0.457137),
+    vec2(-0.203345, 0.620716), vec2( 0.962340,-0.194983), vec2( 0.473434,-0.480026),
+    vec2( 0.519456, 0.767022), vec2( 0.185461,-0.893124), vec2( 0.507431, 0.064425),
+    vec2( 0.896420, 0.412458), vec2(-0.321940,-0.932615), vec2(-0.791559,-0.597710));
+
+float shadowTap(in sampler2DArrayShadow samp, vec4 p, vec2 offset)
 {
-    const vec3 ro = vec3(0);
-    const float ie = 1./5.;
-    mat3 ca = setCamera(ro, rd, 0.);
-    return vec4(ie,ie,-ie, 1.) * vec4((pos-ro)*ca, 1.);
+    return texture( samp, p + vec4(offset, 0, 0) );
 }
 
-float calcShadow(vec3 ro, vec3 rd, in sampler2DShadow samp)
+// z is the distance along the view axis, it picks the cascade
+float calcShadow(vec3 pos, float z, in sampler2DArrayShadow samp)
 {
+    if (z > iSplits.w) return 1.;
+    int k = z < iSplits.x ? 0 : z < iSplits.y ? 1 : z < iSplits.z ? 2 : 3;
+
+    vec2 mapSize = vec2(textureSize(samp, 0).xy);
+    vec2 texel = 1./mapSize;
+    vec3 shadowPos = (iCascade[k] * vec4(pos, 1)).xyz * 0.5 + 0.5;
+    vec4 p = vec4(shadowPos.xy, float(k), shadowPos.z - 0.001);
+
+#ifdef _SHADOW_EARLY_OUT
+    float probe = shadowTap(samp, p, vec2(-2,-2)*texel) + shadowTap(samp, p, vec2( 2,-2)*texel)
+                + shadowTap(samp, p, vec2(-2, 2)*texel) + shadowTap(samp, p, vec2( 2, 2)*texel);
+    if (probe == 0. || probe == 4.) return probe * .25;
+#endif
+
+#if _SHADOW_FILTER == 1
+    // the bilinear compare of every tap covers 2x2 texels, weights and
+    // offsets add up to a 5x5 tent
+    vec2 uv = shadowPos.xy * mapSize;
+    vec2 base = floor(uv + .5);
+    vec2 s = uv + .5 - base;
+    p.xy = (base - .5) * texel;
+
+    vec2 w0 = 4. - 3.*s, w1 = vec2(7), w2 = 1. + 3.*s;
+    vec2 o0 = (3. - 2.*s) / w0 - 2., o1 = (3. + s) / w1, o2 = s / w2 + 2.;
+
+    float sha = 0.0;
+    sha += w0.x*w0.y * shadowTap(samp, p, vec2(o0.x, o0.y)*texel);
+    sha += w1.x*w0.y * shadowTap(samp, p, vec2(o1.x, o0.y)*texel);
+    sha += w2.x*w0.y * shadowTap(samp, p, vec2(o2.x, o0.y)*texel);
+    sha += w0.x*w1.y * shadowTap(samp, p, vec2(o0.x, o1.y)*texel);
+    sha += w1.x*w1.y * shadowTap(samp, p, vec2(o1.x, o1.y)*texel);
+    sha += w2.x*w1.y * shadowTap(samp, p, vec2(o2.x, o1.y)*texel);
+    sha += w0.x*w2.y * shadowTap(samp, p, vec2(o0.x, o2.y)*texel);
+    sha += w1.x*w2.y * shadowTap(samp, p, vec2(o1.x, o2.y)*texel);
+    sha += w2.x*w2.y * shadowTap(samp, p, vec2(o2.x, o2.y)*texel);
+    return sha / 144.;
+#elif _SHADOW_FILTER == 2
+    // rotated per pixel, the banding turns into noise
+    float a = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898,78.233))) * 43758.5453) * 6.2831853;
+    mat2 rot = mat2(cos(a), sin(a), -sin(a), cos(a));
+    float sha = 0.0;
+    for (int i = 0; i < 12; ++i)
+    {
+        sha += shadowTap(samp, p, rot * Poisson[i] * 2.5 * texel);
+    }
+    return sha / 12.;
+#else
     float sha = 0.0;
     float count = 0.0;
-    vec2 mapSize = vec2(textureSize(samp, 0));
-    vec4 shadowPos = World2Clip(ro, rd) * 0.5 + 0.5;
     for (int si = -2; si <= 2; ++si)
     for (int sj = -2; sj <= 2; ++sj)
     {
-        vec4 sp = shadowPos + vec4(vec2(si,sj)/mapSize, vec2(-0.003,0.001));
-        sha += textureProj( samp, sp );
+        sha += shadowTap(samp, p, vec2(si,sj)*texel);
         count += 1.0;
     }
     return sha/count;
+#endif
 }
 
 
-uniform sampler2D iChannel0;
-uniform sampler2DArray iChannel1;
-uniform sampler2D iChannel2;
-uniform sampler2DShadow iChannel3;
-out vec4 fragColor;
-void main()
+vec3 octDecode(vec2 e)
 {
-    const float fov = 1.2;
-    vec2 screenUV = gl_FragCoord.xy/iResolution.xy;
-    vec4 gBuffer1 = texture(iChannel1, vec3(screenUV, 0));
-    vec4 gBuffer2 = texture(iChannel1, vec3(screenUV, 1));
-    float bufferA = texture(iChannel2, screenUV).r;
+    vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.);
+    n.xy += vec2(n.x >= 0. ? -t : t, n.y >= 0. ? -t : t);
+    return normalize(n);
+}
+
+#ifdef _CLUSTERS
+// keep in sync with lightgrid.h
+const int ClusterX = 16, ClusterY = 9, ClusterZ = 24, LightIndexWidth = 1024;
+const float ClusterNear = .1, ClusterFar = 100.;
 
-    if (bufferA == 1.)
+uniform highp sampler2D iChannel12;     // lights, position and radius, color, spot axis and cone
+uniform highp isampler2D iChannel13;    // first index and count per froxel
+uniform highp isampler2D iChannel14;    // light indices
+
+// only the lights binned into the froxel of the pixel, z is the distance
+// along the view axis
+vec3 clusterLights(vec3 pos, vec3 nor, float z)
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / iResolution.xy * vec2(ClusterX, ClusterY)), ivec2(ClusterX-1, ClusterY-1));
+    int slice = clamp(int(log(z / ClusterNear) / log(ClusterFar / ClusterNear) * float(ClusterZ)), 0, ClusterZ-1);
+    ivec2 range = texelFetch(iChannel13, ivec2(tile.x + tile.y*ClusterX, slice), 0).xy;
+
+    vec3 col = vec3(0);
+    for (int k=0; k<range.y; k++)
     {
-        fragColor = vec4(bufferA);
-        return;
+        int index = range.x + k;
+        int i = texelFetch(iChannel14, ivec2(index % LightIndexWidth, index / LightIndexWidth), 0).r;
+        vec4 a = texelFetch(iChannel12, ivec2(0, i), 0);
+        vec3 color = texelFetch(iChannel12, ivec2(1, i), 0).rgb;
+        vec4 spot = texelFetch(iChannel12, ivec2(2, i), 0);
+
+        vec3 l = a.xyz - pos;
+        float d = length(l);
+        l /= d;
+        float fall = clamp(1. - d*d/(a.w*a.w), 0., 1.);
+        float cone = spot.w <= -1. ? 1. : smoothstep(spot.w, mix(spot.w, 1., .25), dot(-l, spot.xyz));
+        col += color * fall*fall * cone * max(dot(nor, l), 0.);
     }
+    return col;
+}
+#endif
+
+// screen uv of a world position in the last frame
+highp vec2 reproject(highp vec3 pos)
+{
+    const float fov = 1.2;
+    highp vec3 q = (pos - _pro) * setCamera(_pro, _pta, 0.0);
+    return (q.xy / q.z * fov * iResolution.y / iResolution.xy + 1.) * .5;
+}
+
+uniform sampler2D iChannel0;
+uniform sampler2D iChannel1;
+uniform highp usampler2D iChannel2;
+uniform sampler2DArrayShadow iChannel3;
+uniform highp sampler2D iChannel11;
+uniform highp sampler2D iChannel16;     // translucent color and coverage, weighted
+uniform sampler2D iChannel15;           // revealage, what the translucent layers let through
+uniform vec2 iJitter;
+#ifdef _CHECKER
+uniform int iParity;
+#endif
+#ifdef _HALF_RES
+uniform highp sampler2D iChannel5;
+#endif
+#ifdef _CONE
+uniform highp sampler2D iChannel6;
+#endif
+layout (location = 0) out vec4 fragColor;
+layout (location = 1) out vec4 fragMotion;
+void main()
+{
+    const float fov = 1.2;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+#ifdef _CHECKER
+    // half the pixels per frame, the resolve fills in the others from the history
+    if (((pixel.x + pixel.y) & 1) != iParity) discard;
+#endif
+    selectTile(gl_FragCoord.xy, iResolution.xy);
+    vec2 gNormal = texelFetch(iChannel1, pixel, 0).rg;
+    uint gId = texelFetch(iChannel2, pixel, 0).r;
 
     vec3 ro = _ro, ta = _ta;
-    vec2 uv = (2.0*gl_FragCoord.xy-iResolution.xy)/iResolution.y;
+    // the rasterized frame is jittered, the rays follow it
+    vec2 uv = (2.0*(gl_FragCoord.xy-iJitter)-iResolution.xy)/iResolution.y;
     mat3 ca = setCamera(ro, ta, 0.0);
     vec3 rd = ca * normalize(vec3(uv, fov));
 
     // compute rasterized polygon depth in world space
-    float dep = texture(iChannel0, screenUV).r *2.0-1.0;
-    vec3 nor = gBuffer1.rgb * 2. - 1.;
+    float dep = texelFetch(iChannel0, pixel, 0).r *2.0-1.0;
+    vec3 nor = octDecode(gNormal * 2. - 1.);
     const float n = 0.1, f = 1000.0;
     const float p10 = (f+n)/(f-n), p11 = -2.0*f*n/(f-n); // from perspective matrix
         dep = p11 / ( (dep-p10) * dot(rd, normalize(ta-ro)) );
 
-    // ray marching
-    float t, i, m;
-    for (t=0.,i=0.; i<100.; i++)
+    // ray marching, never past the rasterized polygons
+    float t = 0., i, m = 0., steps = 100.;
+#ifdef _CONE
+    t = texelFetch(iChannel6, ivec2(gl_FragCoord.xy) / 8, 0).r;
+#endif
+#ifdef _HALF_RES
+    // resume from the half resolution hits of the neighbours when they all
+    // agree, on the raster depth and on the hit itself: where only the SDF
+    // is, the raster depth is the far plane for every neighbour alike
+    {
+        ivec2 base = ivec2(gl_FragCoord.xy - 1.) / 2;
+        ivec2 last = ivec2(iResolution.xy) / 2 - 1;
+        float lo = 1e10, hi = 0.;
+        bool same = true;
+        for (int k=0; k<4; k++)
+        {
+            vec2 s = texelFetch(iChannel5, clamp(base + ivec2(k&1, k>>1), ivec2(0), last), 0).xy;
+            same = same && abs(s.y - dep) < .05*dep;
+            lo = min(lo, s.x);
+            hi = max(hi, s.x);
+        }
+        if (same && hi - lo < .05*lo)
+        {
+            t = max(t, lo*.9);
+            steps = 16.;
+        }
+    }
+#endif
+    for (i=0.; i<steps; i++)
     {
         vec2 h = map(ro + rd*t);
         t += h.x;
         m = h.y;
-        if (h.x < 0.0001 || t > 100.) break;
+        if (h.x < 0.0001 || t > min(dep, 100.)) break;
     }
 
     vec3 col = vec3(0);
@@ -156,27 +276,49 @@ void main()
         { // polygons
             // vec2 uv = matcap(rd, nor);
             // mate = textureLod(iChannel2, uv, 0.).rgb;
-            float id = gBuffer2.r * float(0xff);
+            highp float id = float(gId & 0xffffffu);
             mate = normalize(sin(vec3(1.44,41.322,142.212)*(id + 44.243)));
+            // particles from splat.glsl, all of one dusty color
+            if ((gId >> 16) == 3u) mate = vec3(.8, .65, .45);
         }
 
         const vec3 sun_dir = normalize(vec3(1,2,3));
-        float sha = calcShadow( ro + rd*min(t, dep) + nor*.006, sun_dir, iChannel3 ) * .7 + .3;
+        float z = min(t, dep) * dot(rd, normalize(ta-ro));
+        float sha = calcShadow( ro + rd*min(t, dep) + nor*.006, z, iChannel3 ) * .7 + .3;
 
 #define saturate(x) clamp(x,0.,1.)
         float sun_dif = saturate(dot(nor, sun_dir))*.9+.1;
         float sky_dif = saturate(dot(nor, vec3(0,1,0)))*.15;
         col += vec3(0.9,0.9,0.5)*sun_dif*mate*sha;
         col += vec3(0.5,0.6,0.9)*sky_dif;
+#ifdef _CLUSTERS
+        col += clusterLights(ro + rd*min(t, dep), nor, z) * mate;
+#endif
     } else {
         col += vec3(0.5,0.6,0.9)*1.2 - rd.y*.4;
     }
 
+    { // the translucent layers over it all, averaged by weight in no particular order
+        highp vec4 accum = texelFetch(iChannel16, pixel, 0);
+        float reveal = texelFetch(iChannel15, pixel, 0).r;
+        col = mix(accum.rgb / max(accum.a, 1e-5), col, reveal);
+    }
+
     // col += i/50. * .1;
-    col = mix(col, gBuffer1.rgb, gBuffer2.g); // blend with splats
     col = pow(col, vec3(0.4545));
     fragColor = vec4(col, 1);
 
+    // polygons bring their own motion, the rest only moves with the camera
+    if (t >= dep && dep < 100.)
+    {
+        fragMotion = texelFetch(iChannel11, pixel, 0);
+    }
+    else
+    {
+        highp vec2 cur = (gl_FragCoord.xy - iJitter) / iResolution.xy;
+        fragMotion = vec4(cur - reproject(ro + rd*(t < 100. ? t : 1000.)), 0, 1);
+    }
+
 #if 0
     { // depth test
         // convert camera dist to screen space dist
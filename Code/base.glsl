@@ -6,6 +6,8 @@ layout (std140) uniform INPUT {
     vec2 iResolution; float iTime, _pad1;
     vec3 _ro; float _fov;
     vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
 };
 
 mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
@@ -17,20 +19,29 @@ mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
     return mat3(cu, cv, cw);
 }
 
-mat4 getProjectionMatrix()
+// sub pixel offset of this frame, in pixels
+uniform vec2 iJitter;
+
+mat4 getProjectionMatrix(vec2 jitter)
 {
     float fov = 1.2;
     float n = 0.1, f = 1000.0;
     float p1 = (f+n)/(f-n);
     float p2 = -2.0*f*n/(f-n);
     float ar = iResolution.x/iResolution.y;
-    return mat4(fov/ar, 0,0,0,0, fov, 0,0,0,0, p1,1,0,0,p2,0);
+    vec2 j = 2.*jitter/iResolution.xy;
+    return mat4(fov/ar, 0,0,0,0, fov, 0,0,j.x,j.y, p1,1,0,0,p2,0);
+}
+
+vec4 World2Clip(vec3 pos, vec3 ro, vec3 ta, vec2 jitter)
+{
+    mat3 ca = setCamera(ro, ta, 0.);
+    return getProjectionMatrix(jitter) * vec4((pos-ro)*ca, 1.);
 }
 
 vec4 World2Clip(vec3 pos)
 {
-    mat3 ca = setCamera(_ro, _ta, 0.);
-    return getProjectionMatrix() * vec4((pos-_ro)*ca, 1.);
+    return World2Clip(pos, _ro, _ta, iJitter);
 }
 
 #ifdef _VS
@@ -41,27 +52,163 @@ vec4 World2Clip(vec3 pos)
 
 _varying vec3 vNormal;
 flat _varying int vId;
+// unjittered clip positions of this frame and the last, for the motion vector
+_varying highp vec4 vCurr;
+_varying highp vec4 vPrev;
+#ifdef _PULL
+flat _varying uint vMaterial;
+#endif
 
 #ifdef _VS
-layout (location = 0) in vec3 aVertex;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in highp vec4 aPacked;    // 16 bit grid, mesh in w
+layout (location = 1) in vec2 aOctNormal;
+
+#ifdef _PULL
+// every command of a group in one call, keep in sync with DrawInfo in
+// module.cpp: the draw finds its material and first instance, the instance
+// its transform or its draw id in storage rather than in attributes
+layout (std430, binding = 0) readonly buffer DRAWS { uvec2 iDraw[]; };
+layout (std430, binding = 1) readonly buffer INSTANCES { vec4 iInstance[]; };      // three per Instance
+layout (std430, binding = 2) readonly buffer PREV_INSTANCES { vec4 iPrevInstance[]; };
+layout (std430, binding = 4) readonly buffer DRAW_IDS { uint iDrawId[]; };
+uniform int iFirstDraw;
+
+layout (location = 2) in uvec4 aJoints;
+layout (location = 3) in vec4 aWeights;
+
+// the rotation's columns then the position, twelve floats in a row
+void unpackInstance(vec4 a, vec4 b, vec4 c, out mat3 rot, out vec3 pos)
+{
+    rot = mat3(a.xyz, vec3(a.w, b.xy), vec3(b.zw, c.x));
+    pos = c.yzw;
+}
+
+void main()
+{
+    uvec2 draw = iDraw[iFirstDraw + gl_DrawID];
+    int i = int(draw.y) + gl_InstanceID;
+    vMaterial = draw.x;
+    vec3 vertex = meshVertex(aPacked), normal = meshNormal(aOctNormal);
+    vec3 pos = vertex, nor = normal;
+    mat3 rot; vec3 off;
+    if (draw.x == 0u)
+    { // rigid
+        vId = gl_InstanceID;
+        unpackInstance(iInstance[i*3], iInstance[i*3+1], iInstance[i*3+2], rot, off);
+        nor = normal * rot;
+        pos = vertex * rot + off;
+    }
+    else if (draw.x == 1u)
+    { // skinned
+        vId = int(iDrawId[i]);
+        skin(vId, aJoints, aWeights, pos, nor);
+    }
+    else
+    { // joints
+        vId = int(iDrawId[i]);
+        jointBone(vId, vertex, normal, pos, nor);
+    }
+    vNormal = nor;
+    gl_Position = World2Clip(pos);
+    vCurr = World2Clip(pos, _ro, _ta, vec2(0));
+
+    paletteColumn = PaletteWidth;
+    pos = vertex, nor = normal;
+    if (draw.x == 0u)
+    {
+        unpackInstance(iPrevInstance[i*3], iPrevInstance[i*3+1], iPrevInstance[i*3+2], rot, off);
+        pos = vertex * rot + off;
+    }
+    else if (draw.x == 1u)
+    {
+        skin(vId, aJoints, aWeights, pos, nor);
+    }
+    else
+    {
+        jointBone(vId, vertex, normal, pos, nor);
+    }
+    vPrev = World2Clip(pos, _pro, _pta, vec2(0));
+}
+#elif defined(_SKIN)
+layout (location = 2) in uvec4 aJoints;
+layout (location = 3) in vec4 aWeights;
+layout (location = 9) in uint aDrawId;
+void main()
+{
+    vId = int(aDrawId);
+    vec3 vertex = meshVertex(aPacked), normal = meshNormal(aOctNormal);
+    vec3 pos = vertex, nor = normal;
+    skin(vId, aJoints, aWeights, pos, nor);
+    vNormal = nor;
+    gl_Position = World2Clip(pos);
+    vCurr = World2Clip(pos, _ro, _ta, vec2(0));
+
+    paletteColumn = PaletteWidth;
+    pos = vertex, nor = normal;
+    skin(vId, aJoints, aWeights, pos, nor);
+    vPrev = World2Clip(pos, _pro, _pta, vec2(0));
+}
+#elif defined(_JOINTS)
+layout (location = 9) in uint aDrawId;
+void main()
+{
+    vId = int(aDrawId);
+    vec3 vertex = meshVertex(aPacked), normal = meshNormal(aOctNormal);
+    vec3 pos, nor;
+    jointBone(vId, vertex, normal, pos, nor);
+    vNormal = nor;
+    gl_Position = World2Clip(pos);
+    vCurr = World2Clip(pos, _ro, _ta, vec2(0));
+
+    paletteColumn = PaletteWidth;
+    jointBone(vId, vertex, normal, pos, nor);
+    vPrev = World2Clip(pos, _pro, _pta, vec2(0));
+}
+#else
 layout (location = 4) in mat3 aRotation;
 layout (location = 7) in vec3 aPosition;
+layout (location = 10) in mat3 aPrevRotation;
+layout (location = 13) in vec3 aPrevPosition;
 void main()
 {
     vId = gl_InstanceID;
-    vNormal = aNormal * aRotation;
-    vec3 pos = aVertex.xyz * aRotation + aPosition;
+    vec3 vertex = meshVertex(aPacked);
+    vNormal = meshNormal(aOctNormal) * aRotation;
+    vec3 pos = vertex * aRotation + aPosition;
     gl_Position = World2Clip(pos);
+    vCurr = World2Clip(pos, _ro, _ta, vec2(0));
+    vPrev = World2Clip(vertex * aPrevRotation + aPrevPosition, _pro, _pta, vec2(0));
 }
+#endif
 
 #else
-layout (location = 0) out vec4 fragColor;
-layout (location = 1) out vec4 bufferB;
+// object ids: the instance or draw id, the kind of draw above it, 3 for the
+// particles of splat.glsl
+#if defined(_PULL)
+#define Material vMaterial
+#elif defined(_SKIN)
+const uint Material = 1u;
+#elif defined(_JOINTS)
+const uint Material = 2u;
+#else
+const uint Material = 0u;
+#endif
+
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 s = vec2(n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1.);
+    return n.z >= 0. ? n.xy : (1. - abs(n.yx)) * s;
+}
+
+layout (location = 0) out vec4 fragNormal;
+layout (location = 1) out uint fragId;
+layout (location = 2) out vec4 fragMotion;
 void main(void)
 {
-    vec3 nor = normalize(vNormal) * .5 + .5;
-    fragColor = vec4(nor, 1.);
-    bufferB = vec4(float(vId)/float(0xff), vec2(0.), 1);
+    fragNormal = vec4(octEncode(normalize(vNormal)) * .5 + .5, 0, 1);
+    fragId = (uint(vId) & 0xffffu) | (Material << 16);
+    // screen uv travelled since the last frame
+    fragMotion = vec4((vCurr.xy/vCurr.w - vPrev.xy/vPrev.w) * .5, 0, 1);
 }
 #endif
@@ -0,0 +1,223 @@
+#include "blend.h"
+#include <assert.h>
+
+JointMask MaskChain(IkRig first, IkRig last)
+{
+    JointMask mask = 0;
+    for (int i=first; i<=last; i++)
+    {
+        mask |= JOINT_BIT(i);
+    }
+    return mask;
+}
+
+/************************************************************
+ *                         Pool                             *
+************************************************************/
+
+PosePool::~PosePool()
+{
+    for (Pose *pose : _all)
+    {
+        delete pose;
+    }
+}
+
+Pose *PosePool::Acquire()
+{
+    if (_free.empty())
+    {
+        _all.push_back(new Pose);
+        return _all.back();
+    }
+    Pose *pose = _free.back();
+    _free.pop_back();
+    return pose;
+}
+
+void PosePool::Release(Pose *pose)
+{
+    _free.push_back(pose);
+}
+
+/************************************************************
+ *                        Blending                          *
+************************************************************/
+
+static quat nlerp(quat a, quat b, float t)
+{
+    if (dot(a, b) < 0.f) b = -b;
+    return normalize(a * (1.f-t) + b * t);
+}
+
+void LerpPose(Pose *a, Pose const& b, float t, JointMask mask)
+{
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!(mask & JOINT_BIT(i))) continue;
+        a->joints[i].rot = nlerp(a->joints[i].rot, b.joints[i].rot, t);
+        a->joints[i].pos = mix(a->joints[i].pos, b.joints[i].pos, t);
+    }
+}
+
+static void addPose(Pose *a, Pose const& b, float t, JointMask mask)
+{
+    const quat identity = quat(1,0,0,0);
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!(mask & JOINT_BIT(i))) continue;
+        a->joints[i].rot = normalize(a->joints[i].rot * nlerp(identity, b.joints[i].rot, t));
+        a->joints[i].pos += (b.joints[i].pos - jointsLocal[i]) * t;
+    }
+}
+
+void BindPose(Pose *out, JointMask mask)
+{
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!(mask & JOINT_BIT(i))) continue;
+        out->joints[i] = { quat(1,0,0,0), jointsLocal[i] };
+    }
+}
+
+/************************************************************
+ *                       Blend Tree                         *
+************************************************************/
+
+int BlendTree::AddClip(ClipFunction *clip, void *user)
+{
+    _nodes.push_back({ BlendClip, 1, MaskAll, NullIndex, NullIndex, clip, user, 0 });
+    return _nodes.size()-1;
+}
+
+int BlendTree::AddLerp(int a, int b, float weight)
+{
+    _nodes.push_back({ BlendLerp, weight, MaskAll, a, b, NULL, NULL, 0 });
+    return _nodes.size()-1;
+}
+
+int BlendTree::AddAdditive(int a, int b, float weight)
+{
+    _nodes.push_back({ BlendAdditive, weight, MaskAll, a, b, NULL, NULL, 0 });
+    return _nodes.size()-1;
+}
+
+int BlendTree::AddLayer(int a, int b, float weight, JointMask mask)
+{
+    _nodes.push_back({ BlendLayer, weight, mask, a, b, NULL, NULL, 0 });
+    return _nodes.size()-1;
+}
+
+int BlendTree::PushLayer(int node, float weight, JointMask mask, bool additive)
+{
+    if (_rootIndex == NullIndex)
+    {
+        _rootIndex = node;
+    }
+    else if (additive)
+    {
+        _rootIndex = AddAdditive(_rootIndex, node, weight);
+        _nodes[_rootIndex].mask = mask;
+    }
+    else
+    {
+        _rootIndex = AddLayer(_rootIndex, node, weight, mask);
+    }
+    return _rootIndex;
+}
+
+void BlendTree::Evaluate(PosePool & pool, Pose *out, JointMask mask) const
+{
+    if (_rootIndex == NullIndex)
+    {
+        BindPose(out, mask);
+        return;
+    }
+    EvaluateNode(pool, _rootIndex, mask, out);
+}
+
+// a node only ever writes the joints in 'mask', branches that
+// contribute nothing are never visited
+void BlendTree::EvaluateNode(PosePool & pool, int index, JointMask mask, Pose *out) const
+{
+    if (!mask) return;
+    if (index == NullIndex)
+    {
+        BindPose(out, mask);
+        return;
+    }
+
+    BlendNode const& node = _nodes[index];
+    JointMask sub = mask & node.mask;
+    float w = node.weight;
+
+    switch (node.type)
+    {
+    case BlendClip:
+        node.clip(node.user, node.time, mask, out);
+        break;
+    case BlendLerp:
+        if (w <= 0.f)
+        {
+            EvaluateNode(pool, node.child1, mask, out);
+        }
+        else if (w >= 1.f)
+        {
+            EvaluateNode(pool, node.child2, mask, out);
+        }
+        else
+        {
+            Pose *tmp = pool.Acquire();
+            EvaluateNode(pool, node.child1, mask, out);
+            EvaluateNode(pool, node.child2, mask, tmp);
+            LerpPose(out, *tmp, w, mask);
+            pool.Release(tmp);
+        }
+        break;
+    case BlendAdditive:
+        EvaluateNode(pool, node.child1, mask, out);
+        if (w > 0.f && sub)
+        {
+            Pose *tmp = pool.Acquire();
+            EvaluateNode(pool, node.child2, sub, tmp);
+            addPose(out, *tmp, min(w, 1.f), sub);
+            pool.Release(tmp);
+        }
+        break;
+    case BlendLayer:
+        if (w <= 0.f || !sub)
+        {
+            EvaluateNode(pool, node.child1, mask, out);
+        }
+        else if (w >= 1.f)
+        { // fully overridden joints are never sampled from the base
+            EvaluateNode(pool, node.child1, mask & ~sub, out);
+            EvaluateNode(pool, node.child2, sub, out);
+        }
+        else
+        {
+            Pose *tmp = pool.Acquire();
+            EvaluateNode(pool, node.child1, mask, out);
+            EvaluateNode(pool, node.child2, sub, tmp);
+            LerpPose(out, *tmp, w, sub);
+            pool.Release(tmp);
+        }
+        break;
+    }
+}
+
+/************************************************************
+ *                     Forward Kinematics                   *
+************************************************************/
+
+void PoseToWorld(Pose const& pose, vec3 world[], quat global[])
+{
+    world[Root] = pose.joints[Root].pos;
+    global[Root] = pose.joints[Root].rot;
+    for (int i=Hips; i<Joint_Max; i++)
+    {
+        int p = parentTable[i];
+        world[i] = world[p] + global[p] * pose.joints[i].pos;
+        global[i] = global[p] * pose.joints[i].rot;
+    }
+}
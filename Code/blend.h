@@ -0,0 +1,78 @@
+#ifndef BLEND_H
+#define BLEND_H
+#include "ikrig.h"
+#include <glm/gtc/quaternion.hpp>
+
+typedef struct {
+    quat rot;
+    vec3 pos;
+}Transform;
+
+typedef struct {
+    Transform joints[Joint_Max];
+}Pose;
+
+/// one bit per IkRig joint, a sampler may only write the joints in its mask
+typedef uint32_t JointMask;
+
+#define JOINT_BIT(j) (1u << (j))
+static const JointMask MaskAll = JOINT_BIT(Joint_Max) - 1u;
+
+JointMask MaskChain(IkRig first, IkRig last);
+
+typedef void (ClipFunction)(void *user, float t, JointMask mask, Pose *out);
+
+typedef enum {
+    BlendClip,      // leaf, samples a clip at its own time
+    BlendLerp,      // mix(a, b, weight)
+    BlendAdditive,  // a + b * weight, b holds a delta from the bind pose
+    BlendLayer,     // a with b laid over the joints in mask, by weight
+}BlendType;
+
+typedef struct {
+    BlendType type;
+    float weight;
+    JointMask mask;
+    int child1;
+    int child2;
+    ClipFunction *clip;
+    void *user;
+    float time;
+}BlendNode;
+
+/// scratch poses, recycled within and across evaluations
+struct PosePool
+{
+    vector<Pose*> _free;
+    vector<Pose*> _all;
+
+    ~PosePool();
+    Pose *Acquire();
+    void Release(Pose *pose);
+};
+
+struct BlendTree
+{
+    enum { NullIndex = -1 };
+    vector<BlendNode> _nodes;
+    int _rootIndex = NullIndex;
+
+    int AddClip(ClipFunction *clip, void *user = NULL);
+    int AddLerp(int a, int b, float weight);
+    int AddAdditive(int a, int b, float weight);
+    int AddLayer(int a, int b, float weight, JointMask mask);
+
+    /// layer stack, pushes a node on top of the current root
+    int PushLayer(int node, float weight, JointMask mask, bool additive = false);
+
+    void Evaluate(PosePool & pool, Pose *out, JointMask mask = MaskAll) const;
+    void EvaluateNode(PosePool & pool, int index, JointMask mask, Pose *out) const;
+};
+
+void BindPose(Pose *out, JointMask mask = MaskAll);
+
+void LerpPose(Pose *a, Pose const& b, float t, JointMask mask = MaskAll);
+
+void PoseToWorld(Pose const& pose, vec3 world[], quat global[]);
+
+#endif // BLEND_H
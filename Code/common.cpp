@@ -119,7 +119,7 @@ void lCapsule(vector<vec3> & V, vec3 pa, vec3 pb, float r)
 ************************************************************/
 
 typedef struct { vec3 pos, nor; }Vertex;
-typedef unsigned short Index;
+typedef unsigned int Index;
 
 void tCubeMap(vector<Vertex> &V, vector<Index> &F, int N)
 {
@@ -143,11 +143,11 @@ void tCubeMap(vector<Vertex> &V, vector<Index> &F, int N)
     }
 }
 
-void tCapsule(vector<Vertex> &V, vector<Index> &F, float t)
+void tCapsule(vector<Vertex> &V, vector<Index> &F, float t, int N)
 {
     vec3 h = vec3(0,t,0);
     size_t baseVertex = V.size();
-    tCubeMap(V, F, 32);
+    tCubeMap(V, F, N);
     for (size_t i=baseVertex; i<V.size(); i++)
     {
         vec3 uv = V[i].pos;
@@ -185,6 +185,40 @@ void opElongate(Slice arr, vec3 h)
     }
 }
 
+typedef struct { unsigned short pos[4]; short nor[2]; }PackedVertex;
+
+static vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 s = vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return n.z >= 0.f ? vec2(n.x, n.y) : (1.f - abs(vec2(n.y, n.x))) * s;
+}
+
+void PackVertices(vector<Vertex> const& V, size_t first, int mesh, vec4 box[2], vector<PackedVertex> & out)
+{
+    vec3 lo = vec3(1e9f), hi = vec3(-1e9f);
+    for (size_t i=first; i<V.size(); i++)
+    {
+        lo = min(lo, V[i].pos);
+        hi = max(hi, V[i].pos);
+    }
+    // a flat mesh still gets a grid on its flat axis
+    vec3 ext = max(hi - lo, vec3(1e-6f));
+    box[0] = vec4(lo, 0);
+    box[1] = vec4(ext, 0);
+
+    for (size_t i=first; i<V.size(); i++)
+    {
+        vec3 q = round((V[i].pos - lo) / ext * 65535.f);
+        vec2 n = round(clamp(octEncode(normalize(V[i].nor)), -1.f, 1.f) * 32767.f);
+        PackedVertex p = {
+            { (unsigned short)q.x, (unsigned short)q.y, (unsigned short)q.z, (unsigned short)mesh },
+            { (short)n.x, (short)n.y },
+        };
+        out.push_back(p);
+    }
+}
+
 /************************************************************
  *                       Utilities                          *
 ************************************************************/
@@ -0,0 +1,119 @@
+// prepended to every full screen pass, the scene shared by all of them
+precision mediump float;
+
+float sdBox(vec3 pos, float b)
+{
+    vec3 q = abs(pos) - b;
+    return length(max(q, 0.0));
+}
+
+float sdTorus( vec3 p, vec2 t )
+{
+  vec2 q = vec2(length(p.xz)-t.x,p.y);
+  return length(q)-t.y;
+}
+
+float sdRoundBox( vec3 p, vec3 b, float r )
+{
+  vec3 q = abs(p) - b;
+  return length(max(q,0.0)) + min(max(q.x,max(q.y,q.z)),0.0) - r;
+}
+
+// https://iquilezles.org/articles/smin
+float smin( float a, float b, float k )
+{
+    float h = max(k-abs(a-b),0.0);
+    return min(a, b) - h*h*0.25/k;
+}
+
+//============================================================//
+
+// primitive list, keep in sync with sdfscene.h
+const int SdfTile = 32;
+
+#ifdef _PRIMITIVES
+uniform highp sampler2D iChannel9;   // 5 texels per primitive
+uniform highp isampler2D iChannel10; // rows of count then indices, row 0 holds every primitive
+
+int sdfList = 0;
+
+// a pass only walks the primitives of the screen tile its rays go through
+void selectTile(vec2 fragCoord, vec2 res)
+{
+    ivec2 tile = ivec2(fragCoord) / SdfTile;
+    sdfList = 1 + tile.x + tile.y * ((int(res.x) + SdfTile-1) / SdfTile);
+}
+
+float sdPrimitive(int i, vec3 pos)
+{
+    highp vec4 t0 = texelFetch(iChannel9, ivec2(0, i), 0);
+    highp vec4 t1 = texelFetch(iChannel9, ivec2(1, i), 0);
+    highp vec4 t2 = texelFetch(iChannel9, ivec2(2, i), 0);
+    highp vec4 t3 = texelFetch(iChannel9, ivec2(3, i), 0);
+    vec4 params = texelFetch(iChannel9, ivec2(4, i), 0);
+    vec3 p = (pos - t0.xyz) * mat3(t1.xyz, t2.xyz, t3.xyz);
+
+    return t0.w == 0. ? length(p) - params.x
+        : t0.w == 1. ? sdRoundBox(p, params.xyz, params.w)
+        : sdTorus(p, params.xy);
+}
+#else
+void selectTile(vec2 fragCoord, vec2 res) {}
+#endif
+
+vec2 mapScene(vec3 pos)
+{
+    float d1, d2;
+    d1 = pos.y + .05;
+    float id = 1.;
+#ifdef _PRIMITIVES
+    int n = texelFetch(iChannel10, ivec2(0, sdfList), 0).r;
+    for (int k=1; k<=n; k++)
+    {
+        int i = texelFetch(iChannel10, ivec2(k, sdfList), 0).r;
+        d2 = sdPrimitive(i, pos);
+        float blend = texelFetch(iChannel9, ivec2(1, i), 0).w;
+        if (d2 < d1) id = texelFetch(iChannel9, ivec2(2, i), 0).w;
+        d1 = blend > 0. ? smin(d1, d2, blend) : min(d1, d2);
+    }
+#endif
+
+    return vec2(d1, id);
+}
+
+//============================================================//
+
+// brick atlas bounds, keep in sync with sdfatlas.h
+const vec3 AtlasMin = vec3(-16, -4, -16);
+const float BrickSize = 1.;
+const ivec3 BrickGrid = ivec3(32, 8, 32);
+const int BrickTexels = 8;
+
+#ifdef _ATLAS
+uniform highp sampler3D iChannel7; // bricks, distance and material
+uniform highp sampler3D iChannel8; // per brick, atlas slot or -1 and the distance at its center
+
+// constant cost per step, whatever the scene holds
+vec2 map(vec3 pos)
+{
+    highp vec3 g = (pos - AtlasMin) / BrickSize;
+    if (any(lessThan(g, vec3(0))) || any(greaterThanEqual(g, vec3(BrickGrid))))
+    {
+        return mapScene(pos);
+    }
+
+    highp vec4 brick = texelFetch(iChannel8, ivec3(g), 0);
+    if (brick.x < 0.)
+    { // empty, bounded by the distance at its center
+        float r = length(fract(g) - .5) * BrickSize;
+        return vec2(brick.w - sign(brick.w)*r, 0);
+    }
+    highp vec3 texel = brick.xyz*float(BrickTexels) + .5 + fract(g)*float(BrickTexels-1);
+    return texture(iChannel7, texel / vec3(textureSize(iChannel7, 0))).rg;
+}
+#else
+vec2 map(vec3 pos)
+{
+    return mapScene(pos);
+}
+#endif
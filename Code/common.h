@@ -8,7 +8,46 @@ using namespace glm;
 typedef struct {
     vec3 pos, nor;
 }Vertex;
-typedef unsigned short Index;
+// 32 bit while meshes are built, the element buffer narrows them to 16 bit
+// when no mesh has more than 65536 vertices past its base vertex
+typedef unsigned int Index;
+
+/// boxes the vertex shaders can decode, keep in sync with draw.glsl
+enum { MaxMeshes = 8 };
+
+/// what the vertex buffer holds, 12 bytes for a Vertex's 24: the position on a
+/// 16 bit grid over its mesh's box, the mesh in w, the normal octahedral encoded
+typedef struct {
+    unsigned short pos[4];
+    short nor[2];
+}PackedVertex;
+
+/// joint indices and weights of a skinned vertex, weights sum to 255
+typedef struct {
+    unsigned char joint[4], weight[4];
+}Skin;
+
+typedef struct {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+}Command;
+
+/// what the module hands the renderer every frame
+typedef struct {
+    ivec4 count;        // rigid commands, gizmo vertices, first and count of the joint palette commands
+    vec3 sdfLo, sdfHi;  // SDF region to re-bake, empty when lo > hi
+    int cascades;       // shadow cascades, each with its own commands after the camera's,
+                        // then again with their static casters only
+    int groupCommands;  // commands per camera or cascade
+    int skinLods;       // skinned commands, one per level of detail, ahead of the joints
+    int staticDirty;    // bit per cascade whose static casters must be redrawn
+    ivec2 staticScroll[4]; // per cascade otherwise, the whole texels it moved by across the light
+    int indexSize;      // bytes per index in the element buffer, 2 or 4
+    uint shadowVao;     // vertex array of the cascade draws, the module's own stays bound
+}FrameInfo;
 
 void lBox(vector<vec3> & V, mat3 rot, vec3 pos);
 
@@ -20,7 +59,11 @@ void lCapsule(vector<vec3> & V, vec3 a, vec3 b, float r);
 
 void tCubeMap(vector<Vertex> & V, vector<Index> & F, int N);
 
-void tCapsule(vector<Vertex> & V, vector<Index> & F, float t);
+void tCapsule(vector<Vertex> & V, vector<Index> & F, float t, int N = 32);
+
+/// quantizes V[first, end) as the mesh whose box is written to box, lower
+/// corner then extent
+void PackVertices(vector<Vertex> const& V, size_t first, int mesh, vec4 box[2], vector<PackedVertex> & out);
 
 float hash11(float p);
 
@@ -0,0 +1,47 @@
+#version 300 es
+precision mediump float;
+
+layout (std140) uniform INPUT {
+    vec2 iResolution; float iTime, _pad1;
+    vec3 _ro; float _fov;
+    vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
+};
+
+mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
+{
+    vec3 cw = normalize(ta-ro);
+    vec3 cp = vec3(sin(cr), cos(cr), 0.0);
+    vec3 cu = normalize(cross(cw, cp));
+    vec3 cv = cross(cu, cw);
+    return mat3(cu, cv, cw);
+}
+
+// 1/8 resolution, one cone per 8x8 tile wide enough to hold every ray in it
+out float fragColor;
+void main()
+{
+    const float fov = 1.2, tile = 8.;
+    vec2 fragCoord = gl_FragCoord.xy*tile;
+    selectTile(fragCoord, iResolution.xy);
+
+    vec3 ro = _ro, ta = _ta;
+    vec2 uv = (2.0*fragCoord-iResolution.xy)/iResolution.y;
+    mat3 ca = setCamera(ro, ta, 0.0);
+    vec3 rd = ca * normalize(vec3(uv, fov));
+
+    // cone radius per unit distance, half the tile diagonal with a margin
+    float k = tile*.75 * 2./(iResolution.y*fov);
+
+    // only advance as far as the sphere still covers the whole cone section
+    float t = 0.;
+    for (int i=0; i<64; i++)
+    {
+        float h = map(ro + rd*t).x;
+        float s = (h - k*t) / (1. + k);
+        if (s < 0.0001 || t > 100.) break;
+        t += s;
+    }
+    fragColor = t;
+}
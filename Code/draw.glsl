@@ -0,0 +1,133 @@
+// prepended to every pass drawing geometry, after the defines: the mesh
+// decoding and the skinning that base.glsl and shadowmap.glsl share, and
+// the translucent output of line.glsl and splat.glsl
+precision mediump float;
+
+vec3 qrot(vec4 q, vec3 v)
+{
+    return v + 2.0*cross(q.xyz, cross(q.xyz, v) + q.w*v);
+}
+
+vec4 qmul(vec4 a, vec4 b)
+{
+    return vec4(a.w*b.xyz + b.w*a.xyz + cross(a.xyz, b.xyz), a.w*b.w - dot(a.xyz, b.xyz));
+}
+
+#if defined(_SKIN) || defined(_JOINTS) || defined(_PULL)
+uniform highp usampler2D iJoints;
+
+// palette row 0 holds the bind pose, row c+2 belongs to character c: the
+// root's position as floats, then per joint the rotation as snorms and the
+// position from the root as halves. Last frame's joints follow the current
+// ones from column PaletteWidth, keep in sync with module.cpp
+const int PaletteWidth = 25;
+int paletteColumn = 0;
+
+void paletteJoint(int row, int column, int j, out vec4 q, out vec3 t)
+{
+    highp uvec4 o = texelFetch(iJoints, ivec2(column, row), 0);
+    highp uvec4 p = texelFetch(iJoints, ivec2(column + 1 + j, row), 0);
+    q = normalize(vec4(unpackSnorm2x16(p.x), unpackSnorm2x16(p.y)));
+    t = uintBitsToFloat(o.xyz) + vec3(unpackHalf2x16(p.z), unpackHalf2x16(p.w).x);
+}
+
+void skinJoint(int c, int j, out vec4 q, out vec3 t)
+{
+    vec4 bq; vec3 bind;
+    paletteJoint(0, 0, j, bq, bind);
+    paletteJoint(c+2, paletteColumn, j, q, t);
+    t -= qrot(q, bind);
+}
+
+void skin(int c, uvec4 joints, vec4 weights, inout vec3 pos, inout vec3 nor)
+{
+#ifdef _DQS
+    vec4 real = vec4(0), dual = vec4(0), q0;
+    for (int k=0; k<4; k++)
+    {
+        vec4 q; vec3 t;
+        skinJoint(c, int(joints[k]), q, t);
+        if (k == 0) q0 = q;
+        float w = dot(q, q0) < 0. ? -weights[k] : weights[k];
+        real += q * w;
+        dual += qmul(vec4(t, 0), q) * (.5 * w);
+    }
+    float len = length(real);
+    real /= len;
+    dual /= len;
+    pos = qrot(real, pos) + 2.*(real.w*dual.xyz - dual.w*real.xyz + cross(real.xyz, dual.xyz));
+    nor = qrot(real, nor);
+#else
+    vec3 p = vec3(0), n = vec3(0);
+    for (int k=0; k<4; k++)
+    {
+        vec4 q; vec3 t;
+        skinJoint(c, int(joints[k]), q, t);
+        p += (qrot(q, pos) + t) * weights[k];
+        n += qrot(q, nor) * weights[k];
+    }
+    pos = p;
+    nor = n;
+#endif
+}
+
+// row 1 holds the bone count, then per bone its joint and parent joint and
+// its half extents; bones follow their parent joint and sit between the two
+void jointBone(int id, vec3 vertex, vec3 normal, out vec3 pos, out vec3 nor)
+{
+    int bones = int(texelFetch(iJoints, ivec2(0, 1), 0).x);
+    int c = id / bones, b = id - c*bones;
+    highp uvec4 bone = texelFetch(iJoints, ivec2(1 + b, 1), 0);
+    vec3 sca = vec3(unpackHalf2x16(bone.z), unpackHalf2x16(bone.w).x);
+    int i = int(bone.x & 0xffffu), p = int(bone.x >> 16);
+    vec4 q, qi; vec3 a, o;
+    paletteJoint(c+2, paletteColumn, p, q, o);
+    paletteJoint(c+2, paletteColumn, i, qi, a);
+    pos = qrot(q, vertex * sca) + (a + o) * .5;
+    nor = qrot(q, normal / sca);
+}
+#endif
+
+#ifdef _VS
+// quantization box of every mesh, keep MaxMeshes in sync with common.h
+layout (std140) uniform MESHES {
+    highp vec4 iMeshBox[8*2];   // lower corner then extent
+};
+
+// the 16 bit grid of a packed vertex, its mesh in w
+highp vec3 meshVertex(highp vec4 packed)
+{
+    int mesh = int(packed.w);
+    return iMeshBox[mesh*2].xyz + packed.xyz / 65535. * iMeshBox[mesh*2+1].xyz;
+}
+
+vec3 meshNormal(vec2 oct)
+{
+    vec3 n = vec3(oct, 1. - abs(oct.x) - abs(oct.y));
+    vec2 s = vec2(n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1.);
+    n.xy = n.z >= 0. ? n.xy : (1. - abs(n.yx)) * s;
+    return normalize(n);
+}
+
+// a packed instance, keep in sync with PackedInstance in module.cpp: the
+// quaternion as snorms, then the scale as halves; its position follows
+void unpackPacked(highp uvec4 w, out vec4 q, out vec3 sca)
+{
+    q = normalize(vec4(unpackSnorm2x16(w.x), unpackSnorm2x16(w.y)));
+    sca = vec3(unpackHalf2x16(w.z), unpackHalf2x16(w.w).x);
+}
+#endif
+
+#if defined(_FS) && defined(_TRANSLUCENT)
+// weighted blended order independent transparency, the nearer and the more
+// opaque the heavier, with a depth weight of McGuire and Bavoil
+// @link https://jcgt.org/published/0002/02/09/
+layout (location = 0) out vec4 fragAccum;
+layout (location = 1) out vec4 fragReveal;
+void writeTranslucent(vec3 col, float alpha, float z)
+{
+    float w = alpha * clamp(10. / (1e-5 + pow(z/5., 2.) + pow(z/200., 6.)), 1e-2, 3e3);
+    fragAccum = vec4(col * alpha, alpha) * w;
+    fragReveal = vec4(alpha);
+}
+#endif
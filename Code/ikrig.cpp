@@ -1,38 +1,4 @@
-#include <glm/glm.hpp>
-using namespace glm;
-
-typedef enum {
-    Null = -1,
-
-    Root,
-    Hips,
-    Spine1,
-    Spine2,
-    Spine3,
-    Neck,
-    Head,
-    Head_End,
-
-    Shoulder_R,
-    Elbow_R,
-    Wrist_R,
-    Hand_R,
-    Leg_R,
-    Knee_R,
-    Ankle_R,
-    Toe_R,
-
-    Shoulder_L,
-    Elbow_L,
-    Wrist_L,
-    Hand_L,
-    Leg_L,
-    Knee_L,
-    Ankle_L,
-    Toe_L,
-
-    Joint_Max,
-}IkRig;
+#include "ikrig.h"
 
 extern const IkRig parentTable[] = {
     Null,
@@ -0,0 +1,43 @@
+#ifndef IKRIG_H
+#define IKRIG_H
+#include "common.h"
+
+typedef enum {
+    Null = -1,
+
+    Root,
+    Hips,
+    Spine1,
+    Spine2,
+    Spine3,
+    Neck,
+    Head,
+    Head_End,
+
+    Shoulder_R,
+    Elbow_R,
+    Wrist_R,
+    Hand_R,
+    Leg_R,
+    Knee_R,
+    Ankle_R,
+    Toe_R,
+
+    Shoulder_L,
+    Elbow_L,
+    Wrist_L,
+    Hand_L,
+    Leg_L,
+    Knee_L,
+    Ankle_L,
+    Toe_L,
+
+    Joint_Max,
+}IkRig;
+
+extern const IkRig parentTable[];
+extern const bool hasMesh[];
+extern const vec3 joints[];
+extern const vector<vec3> jointsLocal;
+
+#endif // IKRIG_H
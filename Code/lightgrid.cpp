@@ -0,0 +1,91 @@
+#include "lightgrid.h"
+
+int LightGrid::Add(Light const& light)
+{
+    if (_lights.size() >= LightMaxLights) return -1;
+    _lights.push_back(light);
+    return _lights.size()-1;
+}
+
+static int slice(float z)
+{
+    return int(log(z / ClusterNear) / log(ClusterFar / ClusterNear) * ClusterZ);
+}
+
+void LightGrid::Cull(vec3 ro, vec3 ta, float fov, vec2 res)
+{
+    vec3 cw = normalize(ta-ro);
+    vec3 cu = normalize(cross(cw, vec3(0,1,0)));
+    vec3 cv = cross(cu, cw);
+
+    // froxels touched by every light, the box around its sphere like the
+    // SDF tiles, a spot counts as its whole sphere
+    vector<ivec3> lo(_lights.size()), hi(_lights.size());
+    _clusters.assign(ClusterX*ClusterY*ClusterZ, ivec2(0));
+    for (size_t i=0; i<_lights.size(); i++)
+    {
+        Light const& l = _lights[i];
+        vec3 d = l.pos - ro;
+        float r = l.radius;
+        float x = dot(d, cu), y = dot(d, cv), z = dot(d, cw);
+        lo[i] = ivec3(0), hi[i] = ivec3(-1);
+        if (z + r < ClusterNear || z - r > ClusterFar) continue;
+
+        ivec3 a = ivec3(0), b = ivec3(ClusterX-1, ClusterY-1, ClusterZ-1);
+        a.z = z - r > ClusterNear ? slice(z - r) : 0;
+        b.z = min(slice(z + r), b.z);
+        if (z - r > .1f)
+        {
+            vec2 p = vec2(min((x-r)/(z-r), (x-r)/(z+r)), min((y-r)/(z-r), (y-r)/(z+r)));
+            vec2 q = vec2(max((x+r)/(z-r), (x+r)/(z+r)), max((y+r)/(z-r), (y+r)/(z+r)));
+            p = (p*fov*res.y + res) * .5f / res;
+            q = (q*fov*res.y + res) * .5f / res;
+            if (q.x < 0.f || q.y < 0.f || p.x >= 1.f || p.y >= 1.f) continue;
+            a = ivec3(max(ivec2(p * vec2(ClusterX, ClusterY)), ivec2(a)), a.z);
+            b = ivec3(min(ivec2(q * vec2(ClusterX, ClusterY)), ivec2(b)), b.z);
+        }
+        lo[i] = a, hi[i] = b;
+
+        for (int cz=a.z; cz<=b.z; cz++)
+        for (int cy=a.y; cy<=b.y; cy++)
+        for (int cx=a.x; cx<=b.x; cx++)
+        {
+            _clusters[cx + (cy + cz*ClusterY)*ClusterX].y++;
+        }
+    }
+
+    // the lists packed one after the other, whatever overflows is dropped
+    int first = 0;
+    for (ivec2 & c : _clusters)
+    {
+        c.x = first;
+        c.y = min(c.y, LightMaxIndices - first);
+        first += c.y;
+    }
+    _indices.assign(first, 0);
+
+    vector<int> filled(_clusters.size(), 0);
+    for (size_t i=0; i<_lights.size(); i++)
+    {
+        for (int cz=lo[i].z; cz<=hi[i].z; cz++)
+        for (int cy=lo[i].y; cy<=hi[i].y; cy++)
+        for (int cx=lo[i].x; cx<=hi[i].x; cx++)
+        {
+            int c = cx + (cy + cz*ClusterY)*ClusterX;
+            if (filled[c] < _clusters[c].y)
+            {
+                _indices[_clusters[c].x + filled[c]++] = i;
+            }
+        }
+    }
+}
+
+void LightGrid::Texels(vector<vec4> & T) const
+{
+    for (Light const& l : _lights)
+    {
+        T.push_back(vec4(l.pos, l.radius));
+        T.push_back(vec4(l.color, 0));
+        T.push_back(vec4(l.dir, l.cosAngle));
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+#include "common.h"
+
+// keep in sync with base.frag
+enum {
+    ClusterX = 16,          // froxels across the screen
+    ClusterY = 9,
+    ClusterZ = 24,          // depth slices, exponential from ClusterNear to ClusterFar
+    LightMaxLights = 1024,
+    LightTexels = 3,        // texels per light
+    LightIndexWidth = 1024, // row length of the index texture
+    LightMaxIndices = LightIndexWidth*64,
+};
+static const float ClusterNear = .1f, ClusterFar = 100.f;
+
+typedef struct {
+    vec3 pos;
+    float radius;           // the light fades out to nothing there
+    vec3 color;
+    vec3 dir;               // spot axis
+    float cosAngle;         // cosine of the spot cone, -1 for a point light
+}Light;
+
+/// point and spot lights of the scene, binned into the froxels of the camera
+struct LightGrid
+{
+    vector<Light> _lights;
+    vector<ivec2> _clusters;    // first index and count per froxel, x then y then slice
+    vector<short> _indices;     // light indices, per froxel one after the other
+
+    int Add(Light const& light);
+
+    void Cull(vec3 ro, vec3 ta, float fov, vec2 res);
+
+    /// light texels, LightTexels RGBA per light
+    void Texels(vector<vec4> & T) const;
+};
+
+#endif // LIGHTGRID_H
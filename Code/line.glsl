@@ -5,6 +5,8 @@ layout (std140) uniform INPUT {
     vec2 iResolution; float iTime, _pad1;
     vec3 _ro; float _fov;
     vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
 };
 
 mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
@@ -16,6 +18,9 @@ mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
     return mat3(cu, cv, cw);
 }
 
+// sub pixel offset of this frame, in pixels
+uniform vec2 iJitter;
+
 mat4 getProjectionMatrix()
 {
     float fov = 1.2;
@@ -23,7 +28,8 @@ mat4 getProjectionMatrix()
     float p1 = (f+n)/(f-n);
     float p2 = -2.0*f*n/(f-n);
     float ar = iResolution.x/iResolution.y;
-    return mat4(fov/ar, 0,0,0,0, fov, 0,0,0,0, p1,1,0,0,p2,0);
+    vec2 j = 2.*iJitter/iResolution.xy;
+    return mat4(fov/ar, 0,0,0,0, fov, 0,0,j.x,j.y, p1,1,0,0,p2,0);
 }
 
 vec4 World2Clip(vec3 pos)
@@ -38,6 +44,8 @@ vec4 World2Clip(vec3 pos)
 #define _varying in
 #endif
 
+_varying float vDepth;
+
 #ifdef _VS
 layout (location = 8) in vec4 aVertex;
 uniform mat2x3 iCamera;
@@ -45,17 +53,12 @@ void main()
 {
     vec3 pos = aVertex.xyz;
     gl_Position = World2Clip(pos);
+    vDepth = dot(pos - _ro, normalize(_ta - _ro));
 }
-
 #else
-layout (location = 0) out vec4 fragColor;
-layout (location = 1) out vec4 id;
-layout (location = 2) out float bufferA;
+// the translucent targets, written through draw.glsl
 void main()
 {
-    // vec3 col = normalize(sin(vec3(13.144,412.32,141.212)*v_id));
-    fragColor = vec4(1);
-    id = vec4(1);
-    bufferA = 1.;
+    writeTranslucent(vec3(1), .8, vDepth);
 }
 #endif
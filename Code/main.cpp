@@ -1,12 +1,15 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <dlfcn.h>
 #include <sys/stat.h>
 
-#include <glm/glm.hpp>
-using namespace glm;
+#include "common.h"
+#include "sdfatlas.h"
+#include "rendergraph.h"
+#include "particles.h"
 
 #include <btBulletDynamicsCommon.h>
 #include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
@@ -17,6 +20,17 @@ static void error_callback(int _, const char* desc)
     fprintf(stderr, "ERROR: %s\n", desc);
 }
 
+static float halton(int i, int base)
+{
+    float f = 1, r = 0;
+    for (; i > 0; i /= base)
+    {
+        f /= base;
+        r += f * (i % base);
+    }
+    return r;
+}
+
 int main(int argc, char *argv[])
 {
     btCollisionConfiguration *conf = new btDefaultCollisionConfiguration;
@@ -31,7 +45,7 @@ int main(int argc, char *argv[])
     glfwWindowHint(GLFW_SAMPLES, 4);
 //    glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
 
-    const int RES_X = 16*50, RES_Y = 9*50, RES_W = 1024;
+    const int RES_X = 16*50, RES_Y = 9*50, RES_W = 1024, MAX_CASCADES = 4;
     GLFWwindow *window1;
     { // window1
         int screenWidth, screenHeight;
@@ -46,59 +60,170 @@ int main(int argc, char *argv[])
        // glfwSwapInterval(0);
     }
 
-    GLuint bufferA, tex1, tex2, tex3;
+    GlState state;
+    state.Reset();
+    RenderGraph graph;
+    graph._state = &state;
+
+    // transient targets, allocated by the graph which hands the same texture
+    // to targets whose lifetimes do not overlap
+    const TargetDesc depthDesc = { GL_DEPTH_COMPONENT24, RES_X, RES_Y, 0, GL_NEAREST, false };
+    // octahedral normal, object id, screen motion of the polygons
+    const TargetDesc normalDesc = { GL_RG16, RES_X, RES_Y, 0, GL_NEAREST, false };
+    const TargetDesc idDesc = { GL_R32UI, RES_X, RES_Y, 0, GL_NEAREST, false };
+    const TargetDesc motionDesc = { GL_RG16F, RES_X, RES_Y, 0, GL_NEAREST, false };
+    // translucent color and coverage summed by weight, then the revealage
+    const TargetDesc accumDesc = { GL_RGBA16F, RES_X, RES_Y, 0, GL_NEAREST, false };
+    const TargetDesc revealDesc = { GL_R8, RES_X, RES_Y, 0, GL_NEAREST, false };
+    // one layer per shadow cascade
+    const TargetDesc shadowDesc = { GL_DEPTH_COMPONENT24, RES_W, RES_W, MAX_CASCADES, GL_LINEAR, true };
+    // lighting, then the motion of every pixel for the temporal resolve
+    const TargetDesc colorDesc = { GL_RGBA8, RES_X, RES_Y, 0, GL_LINEAR, false };
+
+    // shadow cascades are drawn layer by layer into their own framebuffer
+    GLuint bufferB;
     {
-        glGenTextures(1, &tex1);
-        glBindTexture(GL_TEXTURE_2D, tex1);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, RES_X, RES_Y);
-        glGenTextures(1, &tex2);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, tex2);
-        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB8, RES_X, RES_Y, 2);
-        glGenTextures(1, &tex3);
-        glBindTexture(GL_TEXTURE_2D, tex3);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, RES_X, RES_Y);
-
-        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-        glGenFramebuffers(1, &bufferA);
-        glBindFramebuffer(GL_FRAMEBUFFER, bufferA);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex1, 0);
-        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex2, 0, 0);
-        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, tex2, 0, 1);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, tex3, 0);        glDrawBuffers(2, drawBuffers);
+        glGenFramebuffers(1, &bufferB);
+        glBindFramebuffer(GL_FRAMEBUFFER, bufferB);
+        glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
-        glDrawBuffers(3, drawBuffers);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
-    GLuint bufferB, tex4;
+
+    // half resolution ray march, hit distance and depth per 2x2 block
+    static const bool halfResMarch = true;
+    const TargetDesc marchDesc = { GL_RG32F, RES_X/2, RES_Y/2, 0, GL_NEAREST, false };
+
+    // cone march prepass, a safe starting distance per 8x8 tile
+    static const bool coneMarch = true;
+    const TargetDesc coneDesc = { GL_R32F, (RES_X+7)/8, (RES_Y+7)/8, 0, GL_NEAREST, false };
+
+    // the scene SDF baked into bricks, sampled instead of evaluated while marching
+    static const bool sdfAtlas = true;
+    SdfAtlas atlas;
+    if (sdfAtlas)
     {
-        glGenTextures(1, &tex4);
-        glBindTexture(GL_TEXTURE_2D, tex4);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, RES_W, RES_W);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        atlas.Init();
+    }
 
-        glGenFramebuffers(1, &bufferB);
-        glBindFramebuffer(GL_FRAMEBUFFER, bufferB);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex4, 0);
+    char marchDefines[128];
+    snprintf(marchDefines, sizeof(marchDefines), "#define _PRIMITIVES\n%s%s",
+             coneMarch ? "#define _CONE\n" : "", sdfAtlas ? "#define _ATLAS\n" : "");
+
+    // point and spot lights binned per froxel by the module, the lighting
+    // pass walks only the list of its own froxel
+    static const bool clusteredLights = true;
+
+    // 0 the 5x5 box, 1 the 9 tap tent, 2 the rotated poisson disk
+    static const int shadowFilter = 1;
+    static const bool shadowEarlyOut = true;
+
+    // static casters are drawn once per cascade into their own layers and
+    // copied under the dynamic ones every frame
+    static const bool shadowCache = true;
+    GLuint bufferE, tex7;
+    {
+        glGenTextures(1, &tex7);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tex7);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, RES_W, RES_W, MAX_CASCADES);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &bufferE);
+        glBindFramebuffer(GL_FRAMEBUFFER, bufferE);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex7, 0, 0);
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
+    // every command of a group in one multi draw with one program, the vertex
+    // stages find their material and instances in storage through gl_DrawID;
+    // the programs ask for GLSL 4.60 where the others are ES 3.00
+    static const bool vertexPulling = false;
+
+    // particles simulated on the GPU from the module's emitters, splatted
+    // into the G-buffer as small spheres
+    static const bool gpuParticles = true;
+    // soft discs in the translucent pass, or lit spheres in the G-buffer
+    static const bool translucentParticles = true;
+    ParticleSystem particles;
+    if (gpuParticles)
+    {
+        particles.Init();
+    }
+
+    // dynamic resolution, the targets keep the window size and the frame is
+    // drawn into their lower left corner, then scaled up to the window
+    static const bool dynamicRes = true;
+    const float targetMs = 12.f, minScale = .5f;
+    float resScale = 1.f, gpuMs = 0.f;
+    GLuint timers[3];
+    glGenQueries(3, timers);
+
+    // temporal antialiasing, the projection is jittered every frame and the
+    // lighting accumulates in a window sized history; the checkerboard lights
+    // half the pixels per frame and leaves the others to the history
+    static const bool temporalAA = true;
+    static const bool checkerLighting = false;
+    const float historyBlend = .1f;
+    const TargetDesc historyDesc = { GL_RGBA16F, RES_X, RES_Y, 0, GL_LINEAR, false };
+    GLuint tex11[2];
+    {
+        glGenTextures(2, tex11);
+        for (int i=0; i<2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, tex11[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, RES_X, RES_Y);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glPointSize(3.0);
+    glLineWidth(1.0);
+
     while (!glfwWindowShouldClose(window1))
     {
         float iTime = glfwGetTime();
         static uint32_t iFrame = -1;
+        iFrame++;
+
+        if (dynamicRes)
+        { // the query of two frames ago, read only once it is ready so nothing stalls
+            GLuint query = timers[(iFrame+1) % 3];
+            GLint available = 0;
+            if (iFrame >= 2) glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 ns;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+                gpuMs = ns * 1e-6f;
+
+                // pixels scale with the area, keep steps small so the size settles
+                float wanted = resScale * sqrt(targetMs / max(gpuMs, .1f));
+                resScale = clamp(mix(resScale, wanted, .1f), minScale, 1.f);
+            }
+            glBeginQuery(GL_TIME_ELAPSED, timers[iFrame % 3]);
+        }
+        // multiples of 8, whole cone march tiles
+        const int viewX = max(8, int(RES_X * resScale) & ~7);
+        const int viewY = max(8, int(RES_Y * resScale) & ~7);
+
+        // the halton (2,3) sequence over 8 frames, centered on the pixel
+        const int phase = iFrame % 8 + 1;
+        const vec2 jitter = temporalAA ? vec2(halton(phase, 2), halton(phase, 3)) - .5f : vec2(0);
+        const int parity = iFrame & 1;
+
         {
             static float fps, lastFrameTime = 0;
 
             float dt = iTime - lastFrameTime; lastFrameTime = iTime;
-            if ((iFrame++ & 0xf) == 0) fps = 1./dt;
-            char title[32];
-            sprintf(title, "%.2f\t\t%.1f fps\t\t%d x %d", iTime, fps, RES_X, RES_Y);
+            if ((iFrame & 0xf) == 0) fps = 1./dt;
+            char title[128];
+            snprintf(title, sizeof(title), "%.2f\t\t%.1f fps\t\t%d x %d\t\t%.1f ms\t\t%d/%d state calls skipped",
+                     iTime, fps, viewX, viewY, gpuMs, state._skipped, state._calls);
             glfwSetWindowTitle(window1, title);
         }
 
@@ -110,14 +235,21 @@ int main(int argc, char *argv[])
         {
             iMouse.y = iMouse.x = 0;
         }
+        // in the pixels of the scaled view the module is handed, so the
+        // camera holds still as the resolution changes
+        iMouse.x *= double(viewX) / RES_X;
+        iMouse.y *= double(viewY) / RES_Y;
 
-        ivec2 count = {};
+        ivec4 count = {};
+        int cascades = 0, groupCommands = 0, staticDirty = 0, skinLods = 0, indexSize = 4;
+        GLuint shadowVao = 0;
+        ivec2 staticScroll[MAX_CASCADES] = {};
 
         {
             static void *libraryHandle = NULL;
             static long lastModTime;
             static const char *libraryFilename="libModule.so";
-            typedef ivec2 (plugFunction1)(float t, uint32_t iFrame, vec2 res, vec4 m, btDynamicsWorld *);
+            typedef FrameInfo (plugFunction1)(float t, uint32_t iFrame, vec2 res, vec4 m, btDynamicsWorld *);
             static plugFunction1 *mainAnimation = NULL;
 
             struct stat libStat;
@@ -145,82 +277,492 @@ int main(int argc, char *argv[])
 
             if (mainAnimation)
             {
-                count = mainAnimation(iTime, iFrame, vec2(RES_X,RES_Y), iMouse, dynamicWorld);
+                FrameInfo info = mainAnimation(iTime, iFrame, vec2(viewX,viewY), iMouse, dynamicWorld);
+                count = info.count;
+                cascades = min(info.cascades, MAX_CASCADES);
+                groupCommands = info.groupCommands;
+                staticDirty = info.staticDirty;
+                for (int k=0; k<cascades; k++) staticScroll[k] = info.staticScroll[k];
+                skinLods = info.skinLods;
+                indexSize = info.indexSize;
+                shadowVao = info.shadowVao;
+                if (sdfAtlas && info.sdfLo.x <= info.sdfHi.x)
+                {
+                    atlas.Invalidate(info.sdfLo, info.sdfHi);
+                }
             }
         }
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>RENDER<<<<<<<<<<<<<<<<<<<<<<
 #define SHADER_DIR "../Code/"
-        int reloadShader1(long*, GLuint, const char*);
-        int reloadShader2(long*, GLuint, const char*);
-
-        glDepthMask(1);
-        glFrontFace(GL_CW);
-        glDepthFunc(GL_LEQUAL);
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_CULL_FACE);
-        glBindFramebuffer(GL_FRAMEBUFFER, bufferB);
-        glViewport(0,0, RES_W, RES_W);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        { // shadow
-            static long lastModTime4;
-            static const GLuint prog4 = glCreateProgram();
-            reloadShader2(&lastModTime4, prog4, SHADER_DIR"shadowmap.glsl");
-            glUseProgram(prog4);
-            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, count.x, 0);
+        int reloadShader1(long*, GLuint, const char*, const char *defines = "");
+        int reloadShader2(long*, GLuint, const char*, const char *defines = "");
+
+        // the joint palette commands, skinned meshes then bones rebuilt from joints,
+        // drop _DQS for linear blend skinning
+        static const char skinDefines[] = "#define _SKIN\n#define _DQS\n";
+        static const char jointDefines[] = "#define _JOINTS\n";
+        // the pulling programs skin as skinDefines do
+        static const char pullDefines[] = "#version 460\n#define _PULL\n#define _DQS\n";
+        const GLenum indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        const void *skinOffset = (void*)(count.z * sizeof(Command));
+        const void *jointOffset = (void*)((count.z+skinLods) * sizeof(Command));
+
+        // the module binds its own textures
+        state.ForgetTextures();
+        state._calls = state._skipped = 0;
+
+        const PassState FullScreen = { false, false, false, false, GL_LESS, GL_CCW };
+        const PassState ShadowState = { true, true, true, false, GL_LEQUAL, GL_CW };
+        const PassState GeometryState = { true, true, true, true, GL_LESS, GL_CCW };
+        const PassState TranslucentState = { true, false, false, true, GL_LESS, GL_CCW };
+
+        graph.Clear();
+        const int depth = graph.Create("depth", depthDesc);
+        const int normal = graph.Create("normal", normalDesc);
+        const int id = graph.Create("id", idDesc);
+        const int motion = graph.Create("motion", motionDesc);
+        const int accum = graph.Create("accum", accumDesc);
+        const int reveal = graph.Create("reveal", revealDesc);
+        const int shadow = graph.Create("shadow", shadowDesc);
+        const int cone = graph.Create("cone", coneDesc);
+        const int march = graph.Create("march", marchDesc);
+        const int color = graph.Create("color", colorDesc);
+        const int pixelMotion = graph.Create("pixel motion", motionDesc);
+        const int shadowStatic = graph.Import("shadow cache", tex7, shadowDesc);
+        const int history = graph.Import("history", tex11[parity], historyDesc);
+        const int lastHistory = graph.Import("last history", tex11[parity ^ 1], historyDesc);
+        const int backbuffer = graph.Import("backbuffer", 0, colorDesc);
+        // a 3D texture, its slices count as layers so it is never attached
+        const int sdf = sdfAtlas ? graph.Import("atlas", atlas._atlas, TargetDesc{ GL_RG16F, 0, 0, SlotsPerAxis*BrickTexels }) : -1;
+
+        // the atlas lands on units 7 and 8 for every pass that marches
+        auto bindAtlas = [&]()
+        {
+            state.BindTexture(7, GL_TEXTURE_3D, sdfAtlas ? atlas._atlas : 0);
+            state.BindTexture(8, GL_TEXTURE_3D, sdfAtlas ? atlas._bricks : 0);
+        };
+
+        if (sdfAtlas)
+        { // sdf bake
+            int pass = graph.AddPass("bake", FullScreen, [&]()
+            {
+                static long lastModTime8, lastModTime9;
+                static const GLuint prog8 = glCreateProgram();
+                static const GLuint prog9 = glCreateProgram();
+                int dirty = reloadShader1(&lastModTime8, prog8, SHADER_DIR"bake.frag", "#define _PRIMITIVES\n#define _COARSE\n");
+                dirty |= reloadShader1(&lastModTime9, prog9, SHADER_DIR"bake.frag", "#define _PRIMITIVES\n");
+                if (dirty)
+                { // the scene itself changed
+                    atlas.Invalidate(vec3(-1e9), vec3(1e9));
+                }
+                if (atlas._pending)
+                { // the bake goes around the cache
+                    atlas.Bake(prog8, prog9);
+                    state.Reset();
+                }
+            });
+            graph.Write(pass, sdf);
         }
-        glDepthFunc(GL_LESS);
-        glFrontFace(GL_CCW);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glEnable(GL_BLEND);
-        glBindFramebuffer(GL_FRAMEBUFFER, bufferA);
-        glViewport(0, 0, RES_X, RES_Y);
-        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+        { // shadow, every cascade draws its own commands into its own layer
+            int pass = graph.AddPass("shadow", ShadowState, [&]()
+            {
+                static long lastModTime4, lastModTime5, lastModTime6, lastModTime13;
+                static const GLuint prog4 = glCreateProgram();
+                static const GLuint prog5 = glCreateProgram();
+                static const GLuint prog6 = glCreateProgram();
+                static const GLuint prog13 = glCreateProgram();
+                if (reloadShader2(&lastModTime4, prog4, SHADER_DIR"shadowmap.glsl"))
+                { // the cached static casters were drawn by the old program
+                    staticDirty = (1 << cascades) - 1;
+                }
+                if (vertexPulling && reloadShader2(&lastModTime13, prog13, SHADER_DIR"shadowmap.glsl", pullDefines))
+                {
+                    glProgramUniform1i(prog13, glGetUniformLocation(prog13, "iJoints"), 4);
+                }
+                if (reloadShader2(&lastModTime5, prog5, SHADER_DIR"shadowmap.glsl", skinDefines))
+                {
+                    glProgramUniform1i(prog5, glGetUniformLocation(prog5, "iJoints"), 4);
+                }
+                if (reloadShader2(&lastModTime6, prog6, SHADER_DIR"shadowmap.glsl", jointDefines))
+                {
+                    glProgramUniform1i(prog6, glGetUniformLocation(prog6, "iJoints"), 4);
+                }
+                const GLuint tex4 = graph.Texture(shadow);
+                state.Viewport(0,0, RES_W, RES_W);
+                // the cascades read packed instances, the module's vertex array
+                // stays bound for everyone else
+                GLint vao;
+                glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+                glBindVertexArray(shadowVao);
+                for (int k=0; k<cascades; k++)
+                {
+                    const size_t group = (k+1) * groupCommands * sizeof(Command);
+                    const size_t staticGroup = (k+1+cascades) * groupCommands * sizeof(Command);
+                    glProgramUniform1i(prog4, glGetUniformLocation(prog4, "iLayer"), k);
+                    state.UseProgram(prog4);
+                    const ivec2 d = staticScroll[k];
+                    if (shadowCache && !(staticDirty & (1 << k)) && d != ivec2(0))
+                    { // scrolled: what stays in view, the strips that came in, then back to the cache
+                        const ivec2 size = RES_W - abs(d);
+                        glCopyImageSubData(tex7, GL_TEXTURE_2D_ARRAY, 0, max(d.x,0),max(d.y,0),k,
+                                           tex4, GL_TEXTURE_2D_ARRAY, 0, max(-d.x,0),max(-d.y,0),k, size.x, size.y, 1);
+                        state.BindFramebuffer(bufferB);
+                        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex4, 0, k);
+                        glEnable(GL_SCISSOR_TEST);
+                        if (d.x)
+                        {
+                            glScissor(d.x > 0 ? size.x : 0, 0, abs(d.x), RES_W);
+                            glClear(GL_DEPTH_BUFFER_BIT);
+                            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)staticGroup, count.x, 0);
+                        }
+                        if (d.y)
+                        {
+                            glScissor(0, d.y > 0 ? size.y : 0, RES_W, abs(d.y));
+                            glClear(GL_DEPTH_BUFFER_BIT);
+                            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)staticGroup, count.x, 0);
+                        }
+                        glDisable(GL_SCISSOR_TEST);
+                        glCopyImageSubData(tex4, GL_TEXTURE_2D_ARRAY, 0, 0,0,k,
+                                           tex7, GL_TEXTURE_2D_ARRAY, 0, 0,0,k, RES_W, RES_W, 1);
+                    }
+                    else if (shadowCache)
+                    {
+                        if (staticDirty & (1 << k))
+                        {
+                            state.BindFramebuffer(bufferE);
+                            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex7, 0, k);
+                            glClear(GL_DEPTH_BUFFER_BIT);
+                            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)staticGroup, count.x, 0);
+                        }
+                        glCopyImageSubData(tex7, GL_TEXTURE_2D_ARRAY, 0, 0,0,k,
+                                           tex4, GL_TEXTURE_2D_ARRAY, 0, 0,0,k, RES_W, RES_W, 1);
+                        state.BindFramebuffer(bufferB);
+                        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex4, 0, k);
+                    }
+                    else
+                    {
+                        state.BindFramebuffer(bufferB);
+                        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tex4, 0, k);
+                        glClear(GL_DEPTH_BUFFER_BIT);
+                        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)staticGroup, count.x, 0);
+                    }
+                    if (vertexPulling)
+                    { // the dynamic casters, rigid, skinned and joints in one call
+                        glProgramUniform1i(prog13, glGetUniformLocation(prog13, "iLayer"), k);
+                        glProgramUniform1i(prog13, glGetUniformLocation(prog13, "iFirstDraw"), (k+1) * groupCommands);
+                        state.UseProgram(prog13);
+                        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)group, groupCommands, 0);
+                        continue;
+                    }
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)group, count.x, 0);
+                    if (skinLods)
+                    { // skinned shadow, a command per level of detail
+                        glProgramUniform1i(prog5, glGetUniformLocation(prog5, "iLayer"), k);
+                        state.UseProgram(prog5);
+                        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (char*)skinOffset + group, skinLods, 0);
+                    }
+                    if (count.w > skinLods)
+                    { // joint shadow
+                        glProgramUniform1i(prog6, glGetUniformLocation(prog6, "iLayer"), k);
+                        state.UseProgram(prog6);
+                        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (char*)jointOffset + group, 1, 0);
+                    }
+                }
+                glBindVertexArray(vao);
+            });
+            graph.Read(pass, shadowStatic);
+            graph.Write(pass, shadowStatic);
+            graph.Write(pass, shadow);
+        }
+
         { // geometry
-            static long lastModTime2;
-            static const GLuint prog2 = glCreateProgram();
-            reloadShader2(&lastModTime2, prog2, SHADER_DIR"base.glsl");
-            glUseProgram(prog2);
-            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, count.x, 0);
+            int pass = graph.AddPass("geometry", GeometryState, [&]()
+            {
+                state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                state.Viewport(0, 0, viewX, viewY);
+                { // an integer attachment takes its own clear
+                    const GLfloat normal[] = { .5f, .5f, 0, 0 };
+                    const GLuint id[] = { 0, 0, 0, 0 };
+                    const GLfloat motion[] = { 0, 0, 0, 0 };
+                    glClearBufferfv(GL_COLOR, 0, normal);
+                    glClearBufferuiv(GL_COLOR, 1, id);
+                    glClearBufferfv(GL_COLOR, 2, motion);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                }
+                if (vertexPulling)
+                { // the camera's commands in one call
+                    static long lastModTime14;
+                    static const GLuint prog14 = glCreateProgram();
+                    if (reloadShader2(&lastModTime14, prog14, SHADER_DIR"base.glsl", pullDefines))
+                    {
+                        glProgramUniform1i(prog14, glGetUniformLocation(prog14, "iJoints"), 4);
+                        glProgramUniform1i(prog14, glGetUniformLocation(prog14, "iFirstDraw"), 0);
+                    }
+                    glProgramUniform2f(prog14, glGetUniformLocation(prog14, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog14);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, NULL, groupCommands, 0);
+                }
+                else
+                {
+                    static long lastModTime2;
+                    static const GLuint prog2 = glCreateProgram();
+                    reloadShader2(&lastModTime2, prog2, SHADER_DIR"base.glsl");
+                    glProgramUniform2f(prog2, glGetUniformLocation(prog2, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog2);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, NULL, count.x, 0);
+                }
+                if (skinLods && !vertexPulling)
+                { // skinned geometry
+                    static long lastModTime3;
+                    static const GLuint prog3 = glCreateProgram();
+                    if (reloadShader2(&lastModTime3, prog3, SHADER_DIR"base.glsl", skinDefines))
+                    {
+                        glProgramUniform1i(prog3, glGetUniformLocation(prog3, "iJoints"), 4);
+                    }
+                    glProgramUniform2f(prog3, glGetUniformLocation(prog3, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog3);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, skinOffset, skinLods, 0);
+                }
+                if (count.w > skinLods && !vertexPulling)
+                { // joint geometry
+                    static long lastModTime7;
+                    static const GLuint prog7 = glCreateProgram();
+                    if (reloadShader2(&lastModTime7, prog7, SHADER_DIR"base.glsl", jointDefines))
+                    {
+                        glProgramUniform1i(prog7, glGetUniformLocation(prog7, "iJoints"), 4);
+                    }
+                    glProgramUniform2f(prog7, glGetUniformLocation(prog7, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog7);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, jointOffset, 1, 0);
+                }
+                if (gpuParticles)
+                { // particles, advanced then splatted unless they are translucent
+                    static long lastModTime10, lastModTime11;
+                    static const GLuint prog10 = particles.CreateProgram();
+                    static const GLuint prog11 = glCreateProgram();
+                    reloadShader2(&lastModTime10, prog10, SHADER_DIR"particle.glsl");
+                    state.UseProgram(prog10);
+                    particles.Simulate();
+                    if (!translucentParticles)
+                    {
+                        reloadShader2(&lastModTime11, prog11, SHADER_DIR"splat.glsl");
+                        glProgramUniform2f(prog11, glGetUniformLocation(prog11, "iJitter"), jitter.x, jitter.y);
+                        state.UseProgram(prog11);
+                        particles.Draw();
+                    }
+                }
+            });
+            graph.Write(pass, depth);
+            graph.Write(pass, normal);
+            graph.Write(pass, id);
+            graph.Write(pass, motion);
         }
-        glDepthMask(0);
-        glPointSize(3.0);
-        glLineWidth(1.0);
-        { // gizmo
-            static long lastModTime;
-            static GLuint prog = glCreateProgram();
-            reloadShader2(&lastModTime, prog, SHADER_DIR"line.glsl");
-            glUseProgram(prog);
-            glDrawArrays(GL_LINES, 0, count.y);
+
+        { // translucent, weighted and blended in any order, the lighting composites it
+            int pass = graph.AddPass("translucent", TranslucentState, [&]()
+            {
+                state.Viewport(0, 0, viewX, viewY);
+                {
+                    const GLfloat accum[] = { 0, 0, 0, 0 };
+                    const GLfloat reveal[] = { 1, 1, 1, 1 };
+                    glClearBufferfv(GL_COLOR, 0, accum);
+                    glClearBufferfv(GL_COLOR, 1, reveal);
+                }
+                // the colors add up, the revealage multiplies down
+                state.BlendFunci(0, GL_ONE, GL_ONE);
+                state.BlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+                if (gpuParticles && translucentParticles)
+                {
+                    static long lastModTime12;
+                    static const GLuint prog12 = glCreateProgram();
+                    reloadShader2(&lastModTime12, prog12, SHADER_DIR"splat.glsl", "#define _TRANSLUCENT\n");
+                    glProgramUniform2f(prog12, glGetUniformLocation(prog12, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog12);
+                    particles.Draw();
+                }
+                { // gizmo
+                    static long lastModTime;
+                    static GLuint prog = glCreateProgram();
+                    reloadShader2(&lastModTime, prog, SHADER_DIR"line.glsl", "#define _TRANSLUCENT\n");
+                    glProgramUniform2f(prog, glGetUniformLocation(prog, "iJitter"), jitter.x, jitter.y);
+                    state.UseProgram(prog);
+                    glDrawArrays(GL_LINES, 0, count.y);
+                }
+            });
+            graph.Read(pass, depth);
+            graph.Write(pass, depth);
+            graph.Write(pass, accum);
+            graph.Write(pass, reveal);
         }
-        glDisable(GL_BLEND);
-        glDisable(GL_DEPTH_TEST);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0,0, RES_X, RES_Y);
-        glClear(GL_COLOR_BUFFER_BIT);
+
+        { // cone march
+            int pass = graph.AddPass("cone march", FullScreen, [&]()
+            {
+                state.Viewport(0,0, (viewX+7)/8, (viewY+7)/8);
+                static long lastModTime;
+                static const GLuint prog = glCreateProgram();
+                reloadShader1(&lastModTime, prog, SHADER_DIR"conemarch.frag", marchDefines);
+                bindAtlas();
+                state.UseProgram(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+            if (sdfAtlas) graph.Read(pass, sdf);
+            graph.Write(pass, cone);
+        }
+
+        { // march
+            int pass = graph.AddPass("march", FullScreen, [&]()
+            {
+                state.Viewport(0,0, viewX/2, viewY/2);
+                static long lastModTime;
+                static const GLuint prog = glCreateProgram();
+                int dirty = reloadShader1(&lastModTime, prog, SHADER_DIR"march.frag", marchDefines);
+                if (dirty)
+                {
+                    GLint iChannel6 = glGetUniformLocation(prog, "iChannel6");
+                    glProgramUniform1i(prog, iChannel6, 6);
+                }
+                state.BindTexture(0, GL_TEXTURE_2D, graph.Texture(depth));
+                state.BindTexture(6, GL_TEXTURE_2D, graph.Texture(cone));
+                bindAtlas();
+                state.UseProgram(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+            graph.Read(pass, depth);
+            if (coneMarch) graph.Read(pass, cone);
+            if (sdfAtlas) graph.Read(pass, sdf);
+            graph.Write(pass, march);
+        }
+
         { // lighting
-            static long lastModTime1;
-            static const GLuint prog1 = glCreateProgram();
-            int dirty = reloadShader1(&lastModTime1, prog1, SHADER_DIR"base.frag");
-            if (dirty)
+            int pass = graph.AddPass("lighting", FullScreen, [&]()
             {
-                GLint iChannel1 = glGetUniformLocation(prog1, "iChannel1");
-                glProgramUniform1i(prog1, iChannel1, 1);
-                GLint iChannel2 = glGetUniformLocation(prog1, "iChannel2");
-                glProgramUniform1i(prog1, iChannel2, 2);
-                GLint iChannel3 = glGetUniformLocation(prog1, "iChannel3");
-                glProgramUniform1i(prog1, iChannel3, 3);
-            }
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, tex1);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D_ARRAY, tex2);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, tex3);
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, tex4);
-            glUseProgram(prog1);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                state.Viewport(0,0, viewX, viewY);
+                static long lastModTime1;
+                static const GLuint prog1 = glCreateProgram();
+                static char defines[256];
+                snprintf(defines, sizeof(defines), "%s%s#define _SHADOW_FILTER %d\n%s%s%s",
+                         halfResMarch ? "#define _HALF_RES\n" : "", marchDefines,
+                         shadowFilter, shadowEarlyOut ? "#define _SHADOW_EARLY_OUT\n" : "",
+                         temporalAA && checkerLighting ? "#define _CHECKER\n" : "",
+                         clusteredLights ? "#define _CLUSTERS\n" : "");
+                int dirty = reloadShader1(&lastModTime1, prog1, SHADER_DIR"base.frag", defines);
+                if (dirty)
+                {
+                    GLint iChannel6 = glGetUniformLocation(prog1, "iChannel6");
+                    glProgramUniform1i(prog1, iChannel6, 6);
+                    GLint iChannel5 = glGetUniformLocation(prog1, "iChannel5");
+                    glProgramUniform1i(prog1, iChannel5, 5);
+                    GLint iChannel1 = glGetUniformLocation(prog1, "iChannel1");
+                    glProgramUniform1i(prog1, iChannel1, 1);
+                    GLint iChannel2 = glGetUniformLocation(prog1, "iChannel2");
+                    glProgramUniform1i(prog1, iChannel2, 2);
+                    GLint iChannel3 = glGetUniformLocation(prog1, "iChannel3");
+                    glProgramUniform1i(prog1, iChannel3, 3);
+                    GLint iChannel11 = glGetUniformLocation(prog1, "iChannel11");
+                    glProgramUniform1i(prog1, iChannel11, 11);
+                    // past the sixteen units in use, 4 holds the joint palette
+                    GLint iChannel16 = glGetUniformLocation(prog1, "iChannel16");
+                    glProgramUniform1i(prog1, iChannel16, 16);
+                    GLint iChannel15 = glGetUniformLocation(prog1, "iChannel15");
+                    glProgramUniform1i(prog1, iChannel15, 15);
+                    for (int unit=12; unit<=14; unit++)
+                    { // the lights the module keeps there
+                        char name[16];
+                        snprintf(name, sizeof(name), "iChannel%d", unit);
+                        glProgramUniform1i(prog1, glGetUniformLocation(prog1, name), unit);
+                    }
+                }
+                glProgramUniform2f(prog1, glGetUniformLocation(prog1, "iJitter"), jitter.x, jitter.y);
+                glProgramUniform1i(prog1, glGetUniformLocation(prog1, "iParity"), parity);
+                state.BindTexture(0, GL_TEXTURE_2D, graph.Texture(depth));
+                state.BindTexture(1, GL_TEXTURE_2D, graph.Texture(normal));
+                state.BindTexture(2, GL_TEXTURE_2D, graph.Texture(id));
+                state.BindTexture(3, GL_TEXTURE_2D_ARRAY, graph.Texture(shadow));
+                state.BindTexture(5, GL_TEXTURE_2D, graph.Texture(march));
+                state.BindTexture(6, GL_TEXTURE_2D, graph.Texture(cone));
+                state.BindTexture(11, GL_TEXTURE_2D, graph.Texture(motion));
+                state.BindTexture(16, GL_TEXTURE_2D, graph.Texture(accum));
+                state.BindTexture(15, GL_TEXTURE_2D, graph.Texture(reveal));
+                bindAtlas();
+                state.UseProgram(prog1);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+            graph.Read(pass, depth);
+            graph.Read(pass, normal);
+            graph.Read(pass, id);
+            graph.Read(pass, motion);
+            graph.Read(pass, accum);
+            graph.Read(pass, reveal);
+            graph.Read(pass, shadow);
+            if (halfResMarch) graph.Read(pass, march);
+            if (coneMarch) graph.Read(pass, cone);
+            if (sdfAtlas) graph.Read(pass, sdf);
+            graph.Write(pass, color);
+            graph.Write(pass, pixelMotion);
+        }
+
+        if (temporalAA)
+        { // resolve into this frame's history, reading the last one
+            int pass = graph.AddPass("resolve", FullScreen, [&]()
+            {
+                state.Viewport(0,0, RES_X, RES_Y);
+                static long lastModTime;
+                static const GLuint prog = glCreateProgram();
+                int dirty = reloadShader1(&lastModTime, prog, SHADER_DIR"taa.frag",
+                                          checkerLighting ? "#define _CHECKER\n" : "");
+                if (dirty)
+                {
+                    GLint iChannel1 = glGetUniformLocation(prog, "iChannel1");
+                    glProgramUniform1i(prog, iChannel1, 1);
+                    GLint iChannel2 = glGetUniformLocation(prog, "iChannel2");
+                    glProgramUniform1i(prog, iChannel2, 2);
+                }
+                glProgramUniform2f(prog, glGetUniformLocation(prog, "iScale"), float(viewX)/RES_X, float(viewY)/RES_Y);
+                glProgramUniform1f(prog, glGetUniformLocation(prog, "iBlend"), iFrame ? historyBlend : 1.f);
+                glProgramUniform1i(prog, glGetUniformLocation(prog, "iParity"), parity);
+                state.BindTexture(0, GL_TEXTURE_2D, graph.Texture(color));
+                state.BindTexture(1, GL_TEXTURE_2D, graph.Texture(pixelMotion));
+                state.BindTexture(2, GL_TEXTURE_2D, graph.Texture(lastHistory));
+                state.UseProgram(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+            graph.Read(pass, color);
+            graph.Read(pass, pixelMotion);
+            graph.Read(pass, lastHistory);
+            graph.Write(pass, history);
+        }
+
+        { // upscale, the history already has the window size
+            int pass = graph.AddPass("upscale", FullScreen, [&]()
+            {
+                state.Viewport(0,0, RES_X, RES_Y);
+                static long lastModTime;
+                static const GLuint prog = glCreateProgram();
+                reloadShader1(&lastModTime, prog, SHADER_DIR"upscale.frag");
+                if (temporalAA)
+                {
+                    glProgramUniform2f(prog, glGetUniformLocation(prog, "iScale"), 1.f, 1.f);
+                }
+                else
+                {
+                    glProgramUniform2f(prog, glGetUniformLocation(prog, "iScale"), float(viewX)/RES_X, float(viewY)/RES_Y);
+                }
+                state.BindTexture(0, GL_TEXTURE_2D, graph.Texture(temporalAA ? history : color));
+                state.UseProgram(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+            graph.Read(pass, temporalAA ? history : color);
+            graph.Write(pass, backbuffer);
+        }
+
+        graph.Compile();
+        graph.Execute();
+        if (dynamicRes)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
         }
 
         glfwSwapBuffers(window1);
@@ -263,7 +805,28 @@ static void detachShaders(GLuint prog)
     }
 }
 
-int loadShader1(GLuint prog, const char *filename)
+// INPUT stays on binding 0, the shadow cascades go on 1, the mesh boxes on 2,
+// the particle emitters on 3
+static void bindBlocks(GLuint prog)
+{
+    GLuint block = glGetUniformBlockIndex(prog, "SHADOW");
+    if (block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(prog, block, 1);
+    }
+    block = glGetUniformBlockIndex(prog, "MESHES");
+    if (block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(prog, block, 2);
+    }
+    block = glGetUniformBlockIndex(prog, "EMITTERS");
+    if (block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(prog, block, 3);
+    }
+}
+
+int loadShader1(GLuint prog, const char *filename, const char *defines)
 {
     FILE *f = fopen(filename, "r");
     if (!f)
@@ -281,9 +844,25 @@ int loadShader1(GLuint prog, const char *filename)
     fread(source1, length, 1, f);
     fclose(f);
 
+    // the shared scene goes in between the defines and the pass
+    long commonLength = 0;
+    FILE *c = fopen(SHADER_DIR"common.glsl", "r");
+    if (c)
+    {
+        fseek(c, 0, SEEK_END);
+        commonLength = ftell(c);
+        rewind(c);
+    }
+    char common[commonLength+1]; common[commonLength] = 0;
+    if (c)
+    {
+        fread(common, commonLength, 1, c);
+        fclose(c);
+    }
+
     detachShaders(prog);
     {
-        const char *string[] = { version, source1 };
+        const char *string[] = { version, defines, common, source1 };
         const GLuint sha = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(sha, sizeof string/sizeof *string, string, NULL);
         glCompileShader(sha);
@@ -324,10 +903,19 @@ int loadShader1(GLuint prog, const char *filename)
 
     glLinkProgram(prog);
     glValidateProgram(prog);
+    bindBlocks(prog);
+
+    // the samplers of common.glsl sit on fixed units
+    for (int unit=7; unit<=10; unit++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "iChannel%d", unit);
+        glProgramUniform1i(prog, glGetUniformLocation(prog, name), unit);
+    }
     return 0;
 }
 
-int loadShader2(GLuint prog, const char *filename)
+int loadShader2(GLuint prog, const char *filename, const char *defines)
 {
     FILE *f = fopen(filename, "r");
     if (!f)
@@ -345,10 +933,30 @@ int loadShader2(GLuint prog, const char *filename)
     fread(source1, length, 1, f);
     fclose(f);
 
+    // defines may open with a version of their own, for what the file's lacks
+    const bool ownVersion = strncmp(defines, "#version", 8) == 0;
+
+    // the shared mesh decoding and skinning go in between the defines and the pass
+    long drawLength = 0;
+    FILE *d = fopen(SHADER_DIR"draw.glsl", "r");
+    if (d)
+    {
+        fseek(d, 0, SEEK_END);
+        drawLength = ftell(d);
+        rewind(d);
+    }
+    char draw[drawLength+1]; draw[drawLength] = 0;
+    if (d)
+    {
+        fread(draw, drawLength, 1, d);
+        fclose(d);
+    }
+
     detachShaders(prog);
     for (int i=0; i<2; i++)
     {
-        const char *string[] = { version, i==0?"#define _VS\n":"#define _FS\n", source1 };
+        const char *string[] = { ownVersion ? defines : version, i==0?"#define _VS\n":"#define _FS\n",
+                                 ownVersion ? "" : defines, draw, source1 };
         const GLuint sha = glCreateShader(i==0?GL_VERTEX_SHADER:GL_FRAGMENT_SHADER);
         glShaderSource(sha, sizeof string/sizeof *string, string, NULL);
         glCompileShader(sha);
@@ -369,34 +977,45 @@ int loadShader2(GLuint prog, const char *filename)
     }
     glLinkProgram(prog);
     glValidateProgram(prog);
+    bindBlocks(prog);
     return 0;
 }
 
-int reloadShaderX(typeof loadShader1 f, long *lastModTime, GLuint prog, const char *filename)
+int reloadShaderX(typeof loadShader1 f, long *lastModTime, GLuint prog, const char *filename, const char *defines)
 {
     struct stat libStat;
-    int err = stat(filename, &libStat);
-    if (err == 0 && *lastModTime != libStat.st_mtime)
+    if (stat(filename, &libStat) != 0)
+    {
+        return 0;
+    }
+    long modTime = libStat.st_mtime;
+    struct stat commonStat;
+    const char *common = f == loadShader1 ? SHADER_DIR"common.glsl" : SHADER_DIR"draw.glsl";
+    if (stat(common, &commonStat) == 0)
+    {
+        modTime = max(modTime, (long)commonStat.st_mtime);
+    }
+    if (*lastModTime != modTime)
     {
-        err = f(prog, filename);
+        int err = f(prog, filename, defines);
         if (err != 1)
         {
             printf("INFO: reloading file %s\n", filename);
-            *lastModTime = libStat.st_mtime;
+            *lastModTime = modTime;
             return 1;
         }
     }
     return 0;
 }
 
-int reloadShader1(long *lastModTime, GLuint prog, const char *filename)
+int reloadShader1(long *lastModTime, GLuint prog, const char *filename, const char *defines)
 {
-    return reloadShaderX(loadShader1, lastModTime, prog, filename);
+    return reloadShaderX(loadShader1, lastModTime, prog, filename, defines);
 }
 
-int reloadShader2(long *lastModTime, GLuint prog, const char *filename)
+int reloadShader2(long *lastModTime, GLuint prog, const char *filename, const char *defines)
 {
-    return reloadShaderX(loadShader2, lastModTime, prog, filename);
+    return reloadShaderX(loadShader2, lastModTime, prog, filename, defines);
 }
 
 #define STB_IMAGE_IMPLEMENTATION
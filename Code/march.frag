@@ -0,0 +1,57 @@
+#version 300 es
+precision mediump float;
+
+layout (std140) uniform INPUT {
+    vec2 iResolution; float iTime, _pad1;
+    vec3 _ro; float _fov;
+    vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
+};
+
+mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
+{
+    vec3 cw = normalize(ta-ro);
+    vec3 cp = vec3(sin(cr), cos(cr), 0.0);
+    vec3 cu = normalize(cross(cw, cp));
+    vec3 cv = cross(cu, cw);
+    return mat3(cu, cv, cw);
+}
+
+// half resolution, one ray per 2x2 block of the lighting pass
+uniform sampler2D iChannel0;
+#ifdef _CONE
+uniform highp sampler2D iChannel6;
+#endif
+out vec2 fragColor;
+void main()
+{
+    const float fov = 1.2;
+    ivec2 pixel = ivec2(gl_FragCoord.xy)*2;
+    vec2 fragCoord = vec2(pixel) + .5;
+    selectTile(fragCoord, iResolution.xy);
+
+    vec3 ro = _ro, ta = _ta;
+    vec2 uv = (2.0*fragCoord-iResolution.xy)/iResolution.y;
+    mat3 ca = setCamera(ro, ta, 0.0);
+    vec3 rd = ca * normalize(vec3(uv, fov));
+
+    float dep = texelFetch(iChannel0, pixel, 0).r *2.0-1.0;
+    const float n = 0.1, f = 1000.0;
+    const float p10 = (f+n)/(f-n), p11 = -2.0*f*n/(f-n);
+        dep = p11 / ( (dep-p10) * dot(rd, normalize(ta-ro)) );
+
+    float t = 0., i;
+#ifdef _CONE
+    t = texelFetch(iChannel6, pixel / 8, 0).r;
+#endif
+    for (i=0.; i<100.; i++)
+    {
+        float h = map(ro + rd*t).x;
+        t += h;
+        if (h < 0.0001 || t > min(dep, 100.)) break;
+    }
+
+    // the depth is kept so the upsampling can tell surfaces apart
+    fragColor = vec2(t, dep);
+}
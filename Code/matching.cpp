@@ -0,0 +1,316 @@
+#include "matching.h"
+#include <assert.h>
+#include <float.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/************************************************************
+ *                    Feature Extraction                    *
+************************************************************/
+
+static void samplePose(MotionClip const& clip, float t, vec3 world[], quat global[])
+{
+    Pose pose;
+    clip.clip(clip.user, t, MaskAll, &pose);
+    PoseToWorld(pose, world, global);
+}
+
+static vec3 facing(quat const global[])
+{
+    vec3 fwd = global[Hips] * vec3(0,0,1);
+    fwd.y = 0;
+    return normalize(fwd);
+}
+
+static void extractFeatures(MotionClip const& clip, float t, float fps, float *out)
+{
+    vec3 world[Joint_Max], prev[Joint_Max];
+    quat global[Joint_Max];
+    samplePose(clip, t - 1.f/fps, prev, global);
+    samplePose(clip, t, world, global);
+
+    // everything is expressed in the root space of the current frame
+    vec3 fwd = facing(global);
+    quat inv = angleAxis(-atan(fwd.x, fwd.z), vec3(0,1,0));
+    vec3 root = world[Root] * vec3(1,0,1);
+
+    for (int k=0; k<TrajectoryPoints; k++)
+    {
+        vec3 futureWorld[Joint_Max];
+        quat futureGlobal[Joint_Max];
+        samplePose(clip, t + (k+1.f)/TrajectoryPoints, futureWorld, futureGlobal);
+        vec3 pos = inv * (futureWorld[Root] * vec3(1,0,1) - root);
+        vec3 dir = inv * facing(futureGlobal);
+        out[FeatureTrajPos + k*2 + 0] = pos.x;
+        out[FeatureTrajPos + k*2 + 1] = pos.z;
+        out[FeatureTrajDir + k*2 + 0] = dir.x;
+        out[FeatureTrajDir + k*2 + 1] = dir.z;
+    }
+
+    const int feet[] = { Ankle_L, Ankle_R };
+    for (int k=0; k<2; k++)
+    {
+        vec3 pos = inv * (world[feet[k]] - root);
+        vec3 vel = inv * (world[feet[k]] - prev[feet[k]]) * fps;
+        for (int c=0; c<3; c++)
+        {
+            out[FeatureFootPos + k*3 + c] = pos[c];
+            out[FeatureFootVel + k*3 + c] = vel[c];
+        }
+    }
+
+    vec3 vel = inv * (world[Hips] - prev[Hips]) * fps;
+    for (int c=0; c<3; c++)
+    {
+        out[FeatureHipVel + c] = vel[c];
+    }
+}
+
+/************************************************************
+ *                         Database                         *
+************************************************************/
+
+int MotionDatabase::AddClip(ClipFunction *clip, void *user, float duration)
+{
+    int frameCount = max(1, int(duration * _fps));
+    _clips.push_back({ clip, user, duration, _frameCount, frameCount });
+    for (int i=0; i<frameCount; i++)
+    {
+        _frameClip.push_back(_clips.size()-1);
+        _frameTime.push_back(i / _fps);
+    }
+    _frameCount += frameCount;
+    return _clips.size()-1;
+}
+
+void MotionDatabase::Build(float trajectoryWeight, float poseWeight)
+{
+    // padding frames sit far away from any query and never win a search
+    const float Far = 1e8f;
+    const int padded = (_frameCount + SmallBox-1) / SmallBox * SmallBox;
+    for (int d=0; d<FeatureCount; d++)
+    {
+        _features[d].assign(padded, Far);
+    }
+
+    float raw[FeatureCount];
+    for (int i=0; i<_frameCount; i++)
+    {
+        extractFeatures(_clips[_frameClip[i]], _frameTime[i], _fps, raw);
+        for (int d=0; d<FeatureCount; d++)
+        {
+            _features[d][i] = raw[d];
+        }
+    }
+
+    // groups share one deviation so their internal proportions survive
+    const int groups[][2] = {
+        { FeatureTrajPos, FeatureTrajDir },
+        { FeatureTrajDir, FeatureFootPos },
+        { FeatureFootPos, FeatureFootVel },
+        { FeatureFootVel, FeatureHipVel },
+        { FeatureHipVel, FeatureCount },
+    };
+    for (auto const& g : groups)
+    {
+        float var = 0;
+        for (int d=g[0]; d<g[1]; d++)
+        {
+            double sum = 0, sum2 = 0;
+            for (int i=0; i<_frameCount; i++)
+            {
+                sum += _features[d][i];
+                sum2 += _features[d][i] * _features[d][i];
+            }
+            _mean[d] = sum / _frameCount;
+            var += max(0.0, sum2 / _frameCount - _mean[d] * _mean[d]);
+        }
+        float weight = g[0] < FeatureFootPos ? trajectoryWeight : poseWeight;
+        float scale = weight / max(sqrt(var / (g[1]-g[0])), 1e-5f);
+        for (int d=g[0]; d<g[1]; d++)
+        {
+            _scale[d] = scale;
+            for (int i=0; i<_frameCount; i++)
+            {
+                _features[d][i] = (_features[d][i] - _mean[d]) * scale;
+            }
+        }
+    }
+
+    const int smallCount = padded / SmallBox;
+    const int largeCount = (padded + LargeBox-1) / LargeBox;
+    for (int d=0; d<FeatureCount; d++)
+    {
+        _smallMin[d].assign(smallCount, FLT_MAX);
+        _smallMax[d].assign(smallCount,-FLT_MAX);
+        _largeMin[d].assign(largeCount, FLT_MAX);
+        _largeMax[d].assign(largeCount,-FLT_MAX);
+        for (int i=0; i<_frameCount; i++)
+        {
+            float v = _features[d][i];
+            int s = i / SmallBox, l = i / LargeBox;
+            _smallMin[d][s] = min(_smallMin[d][s], v);
+            _smallMax[d][s] = max(_smallMax[d][s], v);
+            _largeMin[d][l] = min(_largeMin[d][l], v);
+            _largeMax[d][l] = max(_largeMax[d][l], v);
+        }
+    }
+}
+
+void MotionDatabase::BuildQuery(int frame, vec2 const trajPos[], vec2 const trajDir[], float *query) const
+{
+    for (int k=0; k<TrajectoryPoints; k++)
+    {
+        for (int c=0; c<2; c++)
+        {
+            int p = FeatureTrajPos + k*2 + c;
+            int q = FeatureTrajDir + k*2 + c;
+            query[p] = (trajPos[k][c] - _mean[p]) * _scale[p];
+            query[q] = (trajDir[k][c] - _mean[q]) * _scale[q];
+        }
+    }
+    for (int d=FeatureFootPos; d<FeatureCount; d++)
+    {
+        query[d] = _features[d][frame];
+    }
+}
+
+/************************************************************
+ *                          Search                          *
+************************************************************/
+
+static float boxCost(vector<float> const lo[], vector<float> const hi[], int box,
+                     float const *query, float best)
+{
+    float cost = 0;
+    for (int d=0; d<FeatureCount && cost < best; d++)
+    {
+        float q = query[d];
+        float e = clamp(q, lo[d][box], hi[d][box]) - q;
+        cost += e*e;
+    }
+    return cost;
+}
+
+static float frameCost(MotionDatabase const& db, int frame, float const *query)
+{
+    float cost = 0;
+    for (int d=0; d<FeatureCount; d++)
+    {
+        float e = db._features[d][frame] - query[d];
+        cost += e*e;
+    }
+    return cost;
+}
+
+static void scanLeaf(MotionDatabase const& db, int first, float const *query, float *best, int *bestIndex)
+{
+#ifdef __SSE__
+    __m128 q[FeatureCount];
+    for (int d=0; d<FeatureCount; d++)
+    {
+        q[d] = _mm_set1_ps(query[d]);
+    }
+    for (int i=first; i<first+SmallBox; i+=4)
+    {
+        __m128 acc = _mm_setzero_ps();
+        __m128 bound = _mm_set1_ps(*best);
+        for (int d=0; d<FeatureCount; d++)
+        {
+            __m128 e = _mm_sub_ps(_mm_loadu_ps(&db._features[d][i]), q[d]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(e, e));
+            // all four candidates already lost
+            if ((d & 7) == 7 && _mm_movemask_ps(_mm_cmplt_ps(acc, bound)) == 0) break;
+        }
+        float cost[4];
+        _mm_storeu_ps(cost, acc);
+        for (int k=0; k<4; k++)
+        {
+            if (cost[k] < *best)
+            {
+                *best = cost[k];
+                *bestIndex = i+k;
+            }
+        }
+    }
+#else
+    for (int i=first; i<first+SmallBox; i++)
+    {
+        float cost = frameCost(db, i, query);
+        if (cost < *best)
+        {
+            *best = cost;
+            *bestIndex = i;
+        }
+    }
+#endif
+}
+
+int MotionDatabase::Search(float const *query, float *cost) const
+{
+    float best = FLT_MAX;
+    int bestIndex = -1;
+    const int smallCount = _smallMin[0].size();
+    const int largeCount = _largeMin[0].size();
+    const int ratio = LargeBox / SmallBox;
+
+    for (int l=0; l<largeCount; l++)
+    {
+        if (boxCost(_largeMin, _largeMax, l, query, best) >= best) continue;
+        for (int s=l*ratio; s<min((l+1)*ratio, smallCount); s++)
+        {
+            if (boxCost(_smallMin, _smallMax, s, query, best) >= best) continue;
+            scanLeaf(*this, s*SmallBox, query, &best, &bestIndex);
+        }
+    }
+    if (cost) *cost = best;
+    return bestIndex;
+}
+
+int MotionDatabase::SearchBruteForce(float const *query, float *cost) const
+{
+    float best = FLT_MAX;
+    int bestIndex = -1;
+    for (int i=0; i<_frameCount; i++)
+    {
+        float c = frameCost(*this, i, query);
+        if (c < best)
+        {
+            best = c;
+            bestIndex = i;
+        }
+    }
+    if (cost) *cost = best;
+    return bestIndex;
+}
+
+/************************************************************
+ *                         Playback                         *
+************************************************************/
+
+bool MotionMatcher::Update(MotionDatabase const& db, uint32_t iFrame, float dt,
+                           vec2 const trajPos[], vec2 const trajDir[])
+{
+    assert(db._frameCount > 0);
+    MotionClip const& c = db._clips[clip];
+    time = mod(time + dt, c.duration);
+    frame = c.firstFrame + min(int(time * db._fps), c.frameCount-1);
+
+    // characters are staggered by 'phase' so searches spread over frames
+    if ((iFrame + phase) % interval) return false;
+
+    float query[FeatureCount];
+    db.BuildQuery(frame, trajPos, trajDir, query);
+    float best;
+    int bestIndex = db.Search(query, &best);
+
+    // keep playing unless the jump is clearly better
+    const float Threshold = .1f;
+    if (bestIndex < 0 || best + Threshold >= frameCost(db, frame, query)) return false;
+
+    frame = bestIndex;
+    clip = db._frameClip[bestIndex];
+    time = db._frameTime[bestIndex];
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef MATCHING_H
+#define MATCHING_H
+#include "blend.h"
+
+enum {
+    TrajectoryPoints = 3,
+
+    // feature layout, one float per dimension
+    FeatureTrajPos = 0,                                 // xz at +1/3, +2/3, +1 s
+    FeatureTrajDir = FeatureTrajPos + TrajectoryPoints*2,
+    FeatureFootPos = FeatureTrajDir + TrajectoryPoints*2, // left, right
+    FeatureFootVel = FeatureFootPos + 6,
+    FeatureHipVel  = FeatureFootVel + 6,
+    FeatureCount   = FeatureHipVel + 3,
+
+    // frames per bounding box, the leaf scan works on whole small boxes
+    SmallBox = 16,
+    LargeBox = 64,
+};
+
+typedef struct {
+    ClipFunction *clip;
+    void *user;
+    float duration;
+    int firstFrame;
+    int frameCount;
+}MotionClip;
+
+/// normalized features stored SoA, one padded array per dimension
+struct MotionDatabase
+{
+    float _fps = 30.f;
+    int _frameCount = 0;
+    vector<MotionClip> _clips;
+    vector<int> _frameClip;
+    vector<float> _frameTime;
+    vector<float> _features[FeatureCount];
+    float _mean[FeatureCount];
+    float _scale[FeatureCount];
+
+    // per dimension bounds of each small and large box
+    vector<float> _smallMin[FeatureCount], _smallMax[FeatureCount];
+    vector<float> _largeMin[FeatureCount], _largeMax[FeatureCount];
+
+    int AddClip(ClipFunction *clip, void *user, float duration);
+    void Build(float trajectoryWeight = 1.f, float poseWeight = 1.f);
+
+    /// the pose part comes from 'frame', the trajectory part from the caller,
+    /// both given in the character's root space
+    void BuildQuery(int frame, vec2 const trajPos[], vec2 const trajDir[], float *query) const;
+
+    int Search(float const *query, float *cost = NULL) const;
+    int SearchBruteForce(float const *query, float *cost = NULL) const;
+};
+
+/// per character playback, searches are amortized over 'interval' frames
+struct MotionMatcher
+{
+    int interval = 10;
+    int phase = 0;
+    int frame = 0;
+    int clip = 0;
+    float time = 0;
+
+    bool Update(MotionDatabase const& db, uint32_t iFrame, float dt,
+                vec2 const trajPos[], vec2 const trajDir[]);
+};
+
+#endif // MATCHING_H
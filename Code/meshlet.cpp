@@ -0,0 +1,118 @@
+#include "meshlet.h"
+#include <algorithm>
+
+static void bounds(vector<Vertex> const& V, Index const *F, uint indexCount, size_t baseVertex, Meshlet *m)
+{
+    vec3 lo = vec3(1e9), hi = vec3(-1e9), axis = vec3(0);
+    for (uint i=0; i<indexCount; i+=3)
+    {
+        vec3 a = V[baseVertex + F[i]].pos, b = V[baseVertex + F[i+1]].pos, c = V[baseVertex + F[i+2]].pos;
+        lo = min(lo, min(a, min(b, c)));
+        hi = max(hi, max(a, max(b, c)));
+        vec3 n = cross(b-a, c-a);
+        if (dot(n, n) > 0.f) axis += normalize(n);
+    }
+
+    m->center = (lo + hi) * .5f;
+    m->radius = 0;
+    float mindp = 1;
+    m->axis = dot(axis, axis) > 0.f ? normalize(axis) : vec3(0,0,1);
+    for (uint i=0; i<indexCount; i+=3)
+    {
+        vec3 a = V[baseVertex + F[i]].pos, b = V[baseVertex + F[i+1]].pos, c = V[baseVertex + F[i+2]].pos;
+        m->radius = max(m->radius, max(distance(a, m->center), max(distance(b, m->center), distance(c, m->center))));
+        vec3 n = cross(b-a, c-a);
+        if (dot(n, n) > 0.f) mindp = min(mindp, dot(normalize(n), m->axis));
+    }
+    // a cone past a hemisphere has some triangle facing every direction
+    m->cutoff = mindp <= 0.f ? 1.f : sqrt(1.f - mindp*mindp);
+}
+
+void BuildMeshlets(vector<Vertex> const& V, vector<Index> & F, size_t first, size_t last,
+                   size_t baseVertex, vector<Meshlet> & out)
+{
+    const size_t start = out.size();
+    const int triangles = (last - first) / 3;
+    Index const *tri = &F[first];
+
+    // triangles around every vertex
+    uint vertices = 0;
+    for (size_t i=first; i<last; i++) vertices = std::max(vertices, (uint)F[i]+1);
+    vector<int> offset(size_t(vertices)+1, 0), around(size_t(triangles)*3);
+    for (int i=0; i<triangles*3; i++) offset[tri[i]+1]++;
+    for (uint v=0; v<vertices; v++) offset[v+1] += offset[v];
+    {
+        vector<int> fill(offset.begin(), offset.end()-1);
+        for (int i=0; i<triangles*3; i++) around[fill[tri[i]]++] = i/3;
+    }
+
+    vector<char> used(size_t(triangles), char(0));
+    vector<int> stamp(size_t(vertices), -1);    // meshlet a vertex was last added to
+    vector<Index> sorted;
+    sorted.reserve(last - first);
+    int seed = 0;
+    for (int id=0; ; id++)
+    {
+        while (seed < triangles && used[seed]) seed++;
+        if (seed == triangles) break;
+
+        Meshlet m = {};
+        m.firstIndex = first + sorted.size();
+        vector<int> members;
+        members.push_back(seed);
+        used[seed] = 1;
+        for (int k=0; k<3; k++)
+        {
+            if (stamp[tri[seed*3+k]] != id) m.vertexCount++;
+            stamp[tri[seed*3+k]] = id;
+        }
+
+        for (size_t next=0; next<members.size() && members.size() < MeshletTriangles; next++)
+        {
+            // the unused neighbours of the triangles so far, cheapest first
+            for (int k=0; k<3 && members.size() < MeshletTriangles; k++)
+            {
+                Index v = tri[members[next]*3+k];
+                for (int a=offset[v]; a<offset[v+1]; a++)
+                {
+                    int t = around[a];
+                    if (used[t]) continue;
+                    uint added = 0;
+                    for (int j=0; j<3; j++) added += stamp[tri[t*3+j]] != id;
+                    if (m.vertexCount + added > MeshletVertices) continue;
+
+                    used[t] = 1;
+                    members.push_back(t);
+                    m.vertexCount += added;
+                    for (int j=0; j<3; j++) stamp[tri[t*3+j]] = id;
+                    if (members.size() == MeshletTriangles) break;
+                }
+            }
+        }
+
+        for (int t : members)
+        {
+            sorted.push_back(tri[t*3]);
+            sorted.push_back(tri[t*3+1]);
+            sorted.push_back(tri[t*3+2]);
+        }
+        m.indexCount = members.size() * 3;
+        out.push_back(m);
+    }
+
+    std::copy(sorted.begin(), sorted.end(), F.begin() + first);
+    for (size_t i=start; i<out.size(); i++)
+    {
+        bounds(V, &F[out[i].firstIndex], out[i].indexCount, baseVertex, &out[i]);
+    }
+}
+
+bool MeshletCulled(Meshlet const& m, mat3 rot, vec3 pos, vec3 eye)
+{
+    // instances are row vectors times rot, as in the vertex shader
+    vec3 center = m.center * rot + pos;
+    vec3 axis = normalize(m.axis * rot);
+    vec3 d = center - eye;
+    float radius = m.radius * max(length(rot[0]), max(length(rot[1]), length(rot[2])));
+    return dot(d, axis) >= m.cutoff * length(d) + radius;
+}
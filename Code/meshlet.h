@@ -0,0 +1,30 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+#include "common.h"
+
+enum {
+    MeshletVertices = 64,   // unique vertices per meshlet
+    MeshletTriangles = 124,
+};
+
+/// a run of triangles sharing few vertices, drawable as its own command and
+/// bounded well enough to be culled alone
+typedef struct {
+    uint firstIndex, indexCount;    // into the mesh's index range
+    uint vertexCount;
+    vec3 center;                    // bounding sphere, in mesh space
+    float radius;
+    vec3 axis;                      // normal cone, every triangle faces within
+    float cutoff;                   // sine of its half angle, 1 when it never culls
+}Meshlet;
+
+/// regroups the triangles of F[first, last) into meshlets in place, each grown
+/// from a seed triangle by the neighbours adding the fewest new vertices
+void BuildMeshlets(vector<Vertex> const& V, vector<Index> & F, size_t first, size_t last,
+                   size_t baseVertex, vector<Meshlet> & out);
+
+/// whether every triangle of a meshlet of an instance faces away from eye,
+/// exact for a uniform scale only as the cone stretches with the mesh
+bool MeshletCulled(Meshlet const& m, mat3 rot, vec3 pos, vec3 eye);
+
+#endif // MESHLET_H
@@ -0,0 +1,194 @@
+#include "meshopt.h"
+#include <algorithm>
+#include <math.h>
+
+float MeshACMR(vector<Index> const& F, size_t first, size_t last, int cacheSize)
+{
+    if (last <= first) return 0.f;
+    vector<Index> cache;    // most recent first
+    int misses = 0;
+    for (size_t i=first; i<last; i++)
+    {
+        auto it = std::find(cache.begin(), cache.end(), F[i]);
+        if (it != cache.end())
+        {
+            cache.erase(it);
+        }
+        else
+        {
+            misses++;
+            if ((int)cache.size() == cacheSize) cache.pop_back();
+        }
+        cache.insert(cache.begin(), F[i]);
+    }
+    return misses * 3.f / (last - first);
+}
+
+// the scores assume a larger cache than the model, as the paper tunes them
+static const int ScoredCache = 32;
+
+/// @link https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+static float vertexScore(int cachePos, int remaining)
+{
+    if (remaining == 0) return -1.f;
+    // the three of the last triangle score alike, it was just drawn
+    float score = cachePos < 0 ? 0.f : cachePos < 3 ? .75f
+                : powf(1.f - (cachePos - 3) / float(ScoredCache - 3), 1.5f);
+    // vertices with few triangles left get finished off first
+    return score + 2.f * powf((float)remaining, -.5f);
+}
+
+void OptimizeVertexCache(vector<Index> & F, size_t first, size_t last)
+{
+    const int triangles = (last - first) / 3;
+    if (triangles < 2) return;
+    Index const *tri = &F[first];
+
+    // triangles around every vertex
+    uint vertices = 0;
+    for (size_t i=first; i<last; i++) vertices = std::max(vertices, (uint)F[i]+1);
+    vector<int> offset(size_t(vertices)+1, 0), around(size_t(triangles)*3);
+    for (int i=0; i<triangles*3; i++) offset[tri[i]+1]++;
+    for (uint v=0; v<vertices; v++) offset[v+1] += offset[v];
+    {
+        vector<int> fill(offset.begin(), offset.end()-1);
+        for (int i=0; i<triangles*3; i++) around[fill[tri[i]]++] = i/3;
+    }
+
+    vector<int> remaining(size_t(vertices), 0), cachePos(size_t(vertices), -1);
+    vector<float> score(size_t(vertices), 0.f), triScore(size_t(triangles), 0.f);
+    vector<char> added(size_t(triangles), char(0));
+    for (uint v=0; v<vertices; v++)
+    {
+        remaining[v] = offset[v+1] - offset[v];
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    for (int t=0; t<triangles; t++)
+    {
+        triScore[t] = score[tri[t*3]] + score[tri[t*3+1]] + score[tri[t*3+2]];
+    }
+
+    vector<int> cache;  // most recent first, may overflow by a triangle
+    vector<Index> sorted;
+    sorted.reserve(last - first);
+    int best = -1;
+    for (int emitted=0; emitted<triangles; emitted++)
+    {
+        if (best < 0)
+        { // nothing in the cache touches a triangle left, take the best of the rest
+            float bestScore = -1e9f;
+            for (int t=0; t<triangles; t++)
+            {
+                if (!added[t] && triScore[t] > bestScore) bestScore = triScore[t], best = t;
+            }
+        }
+
+        added[best] = 1;
+        for (int k=0; k<3; k++)
+        {
+            int v = tri[best*3+k];
+            sorted.push_back(v);
+            remaining[v]--;
+            auto it = std::find(cache.begin(), cache.end(), v);
+            if (it != cache.end()) cache.erase(it);
+            cache.insert(cache.begin(), v);
+        }
+
+        // rescore what the cache holds and what just fell out of it
+        for (size_t i=0; i<cache.size(); i++)
+        {
+            int v = cache[i];
+            cachePos[v] = i < ScoredCache ? (int)i : -1;
+            score[v] = vertexScore(cachePos[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1e9f;
+        for (size_t i=0; i<cache.size(); i++)
+        {
+            int v = cache[i];
+            for (int a=offset[v]; a<offset[v+1]; a++)
+            {
+                int t = around[a];
+                if (added[t]) continue;
+                triScore[t] = score[tri[t*3]] + score[tri[t*3+1]] + score[tri[t*3+2]];
+                if (i < ScoredCache && triScore[t] > bestScore) bestScore = triScore[t], best = t;
+            }
+        }
+        if (cache.size() > ScoredCache) cache.resize(ScoredCache);
+    }
+
+    // an order that came in well grouped may already beat the greedy one
+    if (MeshACMR(sorted, 0, sorted.size()) < MeshACMR(F, first, last))
+    {
+        std::copy(sorted.begin(), sorted.end(), F.begin() + first);
+    }
+}
+
+void OptimizeOverdraw(vector<Index> & F, Meshlet *M, int count)
+{
+    if (count < 2) return;
+    const size_t first = M[0].firstIndex;
+
+    // the center of the mesh, weighted by triangles
+    vec3 center = vec3(0);
+    float weight = 0;
+    for (int i=0; i<count; i++)
+    {
+        center += M[i].center * float(M[i].indexCount);
+        weight += M[i].indexCount;
+    }
+    center /= weight;
+
+    // meshlets facing away from the center tend to hide those that do not,
+    // a cone facing every direction counts for less
+    vector<float> score(count);
+    vector<int> order(count);
+    for (int i=0; i<count; i++)
+    {
+        score[i] = dot(M[i].center - center, M[i].axis) * (1.f - M[i].cutoff * .5f);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return score[a] > score[b]; });
+
+    vector<Index> sorted;
+    vector<Meshlet> moved;
+    for (int i : order)
+    {
+        Meshlet m = M[i];
+        sorted.insert(sorted.end(), F.begin() + m.firstIndex, F.begin() + m.firstIndex + m.indexCount);
+        m.firstIndex = first + sorted.size() - m.indexCount;
+        moved.push_back(m);
+    }
+    std::copy(sorted.begin(), sorted.end(), F.begin() + first);
+    std::copy(moved.begin(), moved.end(), M);
+}
+
+void OptimizeVertexFetch(vector<Vertex> & V, vector<Skin> & S, vector<Index> & F,
+                         size_t first, size_t last, size_t baseVertex)
+{
+    const size_t count = V.size() - baseVertex;
+    vector<int> remap(count, -1);
+    int next = 0;
+    for (size_t i=first; i<last; i++)
+    {
+        if (remap[F[i]] < 0) remap[F[i]] = next++;
+        F[i] = remap[F[i]];
+    }
+    // vertices no triangle uses keep their order behind the others
+    for (size_t v=0; v<count; v++)
+    {
+        if (remap[v] < 0) remap[v] = next++;
+    }
+
+    {
+        vector<Vertex> moved(count);
+        for (size_t v=0; v<count; v++) moved[remap[v]] = V[baseVertex + v];
+        std::copy(moved.begin(), moved.end(), V.begin() + baseVertex);
+    }
+    if (S.size() >= V.size())
+    {
+        vector<Skin> moved(count);
+        for (size_t v=0; v<count; v++) moved[remap[v]] = S[baseVertex + v];
+        std::copy(moved.begin(), moved.end(), S.begin() + baseVertex);
+    }
+}
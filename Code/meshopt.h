@@ -0,0 +1,27 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+#include "common.h"
+#include "meshlet.h"
+
+/// vertices the post transform cache is modelled with, least recently used,
+/// the small end of what the hardware keeps
+enum { VertexCacheSize = 16 };
+
+/// average cache miss ratio, vertices transformed per triangle of F[first, last)
+float MeshACMR(vector<Index> const& F, size_t first, size_t last, int cacheSize = VertexCacheSize);
+
+/// reorders the triangles of F[first, last) for the vertex cache, after Tom
+/// Forsyth's linear speed vertex cache optimisation
+void OptimizeVertexCache(vector<Index> & F, size_t first, size_t last);
+
+/// orders the count meshlets of a mesh, which lie one after the other, against
+/// overdraw: those on the outside and facing away from the center first, their
+/// triangles moving along; after Sander, Nehab and Barczak's fast reordering
+void OptimizeOverdraw(vector<Index> & F, Meshlet *M, int count);
+
+/// renumbers the vertices past baseVertex in the order the triangles first use
+/// them, the skin follows when S spans them too
+void OptimizeVertexFetch(vector<Vertex> & V, vector<Skin> & S, vector<Index> & F,
+                         size_t first, size_t last, size_t baseVertex);
+
+#endif // MESHOPT_H
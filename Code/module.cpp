@@ -1,5 +1,17 @@
 #include "common.h"
+#include "ikrig.h"
+#include "blend.h"
+#include "matching.h"
+#include "animlod.h"
+#include "sdfscene.h"
+#include "shadow.h"
+#include "lightgrid.h"
+#include "meshlet.h"
+#include "meshopt.h"
+#include <glm/gtc/packing.hpp>
 #include <stdio.h>
+#include <assert.h>
+#include <algorithm>
 
 template<class T> static vector<T> &operator<<(vector<T> &a, T const& b) { a.push_back(b); return a; }
 
@@ -19,46 +31,71 @@ typedef struct {
     vec3 pos;
 }Instance;
 
+/// an Instance in 28 bytes for 48: rotation and scale apart, as four snorm16
+/// then three halves, the position kept whole
 typedef struct {
-    uint count;
-    uint instanceCount;
-    uint firstIndex;
-    uint baseVertex;
-    uint baseInstance;
-}Command;
+    uint rot[2];
+    uint sca[2];
+    vec3 pos;
+}PackedInstance;
 
-typedef enum {
-    Null = -1,
-
-    Root,
-    Hips,
-    Spine1,
-    Spine2,
-    Spine3,
-    Neck,
-    Head,
-    Head_End,
-
-    Shoulder_R,
-    Elbow_R,
-    Wrist_R,
-    Hand_R,
-    Leg_R,
-    Knee_R,
-    Ankle_R,
-    Toe_R,
-
-    Shoulder_L,
-    Elbow_L,
-    Wrist_L,
-    Hand_L,
-    Leg_L,
-    Knee_L,
-    Ankle_L,
-    Toe_L,
-
-    Joint_Max,
-}IkRig;
+static PackedInstance packInstance(Instance const& inst)
+{
+    // rows of rot are the rotation's scaled by the scale along them
+    mat3 r = transpose(inst.rot);
+    vec3 sca = vec3(length(r[0]), length(r[1]), length(r[2]));
+    quat q = quat_cast(mat3(r[0] / sca.x, r[1] / sca.y, r[2] / sca.z));
+    return PackedInstance{
+        { packSnorm2x16(vec2(q.x, q.y)), packSnorm2x16(vec2(q.z, q.w)) },
+        { packHalf2x16(vec2(sca.x, sca.y)), packHalf2x16(vec2(sca.z, 0)) },
+        inst.pos };
+}
+
+/// levels of detail of the skinned mesh, the subdivision of its capsules
+static const int SkinLods = 3;
+static const int SkinLodDetail[SkinLods] = { 8, 4, 2 };
+
+/// one set of commands, the camera's or a shadow cascade's
+typedef struct {
+    int firstInstance, instances;                   // rigid instances
+    int firstSkinned[SkinLods], skinned[SkinLods];  // draw ids of skinned characters, per level
+    int firstJoint, joints;                         // draw ids of bones rebuilt from joints
+}DrawGroup;
+
+/// what a command finds through gl_DrawID when the vertex stage pulls its
+/// instances, one per command; keep in sync with base.glsl and shadowmap.glsl
+typedef struct {
+    uint material;  // as in the object ids, 0 rigid, 1 skinned, 2 joints
+    uint first;     // first instance, or first draw id of the palette commands
+}DrawInfo;
+
+/// layout of the SHADOW block
+typedef struct {
+    mat4 cascade[CascadeCount];
+    vec4 splits;
+}ShadowBlock;
+
+/// layout of the MESHES block, the box every packed mesh was quantized over
+typedef struct {
+    vec4 box[MaxMeshes][2];
+}MeshBlock;
+
+/// where the GPU particles spawn, keep in sync with particle.glsl and splat.glsl
+static const int MaxEmitters = 64;
+
+typedef struct {
+    vec3 pos; float radius;         // spawn sphere
+    vec3 vel; float spread;         // initial velocity, scattered by up to spread
+    float rate, life, size, _pad;   // particles per second, seconds they live, their radius
+}Emitter;
+
+/// layout of the EMITTERS block
+typedef struct {
+    int count;
+    float dt;
+    float _pad[2];
+    Emitter emitter[MaxEmitters];
+}EmitterBlock;
 
 static const int RagdollJoints[][2] = {
     Hips, Neck,
@@ -109,6 +146,217 @@ struct AabbTree
     }
 };
 
+/************************************************************
+ *                     Procedural Clips                     *
+************************************************************/
+
+static void setJoint(Pose *out, JointMask mask, int j, quat rot)
+{
+    if (mask & JOINT_BIT(j)) out->joints[j].rot = rot;
+}
+
+static void clipIdle(void *, float t, JointMask mask, Pose *out)
+{
+    const vec3 X = vec3(1,0,0), Z = vec3(0,0,1);
+    float breath = sin(t * 2.f) * .03f;
+    BindPose(out, mask);
+    setJoint(out, mask, Spine2, angleAxis(breath, X));
+    setJoint(out, mask, Shoulder_R, angleAxis(-1.2f - breath, Z));
+    setJoint(out, mask, Shoulder_L, angleAxis( 1.2f + breath, Z));
+}
+
+static const float WalkSpeed = 1.2f;
+
+static void clipWalk(void *, float t, JointMask mask, Pose *out)
+{
+    const vec3 X = vec3(1,0,0), Y = vec3(0,1,0), Z = vec3(0,0,1);
+    float ph = t * float(M_PI) * 2.f;
+    float s = sin(ph), c = cos(ph);
+    BindPose(out, mask);
+    if (mask & JOINT_BIT(Root)) out->joints[Root].pos.z = t * WalkSpeed;
+    if (mask & JOINT_BIT(Hips)) out->joints[Hips].pos.y += cos(ph*2.f) * .03f;
+    setJoint(out, mask, Spine1, angleAxis(s * .1f, Y));
+    setJoint(out, mask, Leg_R, angleAxis(-s * .5f, X));
+    setJoint(out, mask, Leg_L, angleAxis( s * .5f, X));
+    setJoint(out, mask, Knee_R, angleAxis(max(0.f, c) * .8f, X));
+    setJoint(out, mask, Knee_L, angleAxis(max(0.f,-c) * .8f, X));
+    setJoint(out, mask, Shoulder_R, angleAxis(s * .4f, Y) * angleAxis(-1.3f, Z));
+    setJoint(out, mask, Shoulder_L, angleAxis(s * .4f, Y) * angleAxis( 1.3f, Z));
+}
+
+static void clipWave(void *, float t, JointMask mask, Pose *out)
+{
+    const vec3 Z = vec3(0,0,1);
+    BindPose(out, mask);
+    setJoint(out, mask, Shoulder_R, angleAxis(.6f, Z));
+    setJoint(out, mask, Elbow_R, angleAxis(1.f + sin(t * 8.f) * .4f, Z));
+}
+
+/************************************************************
+ *                          Crowd                           *
+************************************************************/
+
+static const int CrowdSize = 25;
+
+typedef struct {
+    vec3 pos;
+    float lastTime;
+    float locomotion = 0;
+    float clipTime[2] = {}; // idle then walk, the tree is shared by the crowd
+    MotionMatcher matcher;
+}Character;
+
+typedef enum {
+    DrawBones,      // one rigid instance per bone, built on the cpu
+    DrawJoints,     // joint transforms only, bones rebuilt in the vertex shader
+    DrawSkinned,    // one skinned mesh per character
+}CharacterMode;
+
+static const CharacterMode characterMode = DrawSkinned;
+
+/// half extents of the bone ending at joint i, in the bind pose
+static vec3 boneScale(int i)
+{
+    int p = parentTable[i];
+    float w = .2 + hash11(i + 349) * .1;
+        w *= 1 - (i>Shoulder_R || p == Neck) * .5;
+    float r = length(jointsLocal[i]);
+    mat3 rot = rotationAlign(jointsLocal[i]/r, vec3(0,0,1));
+    return abs(rot * vec3(w,w,r)) * .5f;
+}
+
+static void boneInstances(vector<Instance> & I, vec3 const world[], quat const global[], vec3 offset)
+{
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!hasMesh[i]) continue;
+
+        int p = parentTable[i];
+        vec3 sca = boneScale(i);
+        mat3 local = transpose(mat3_cast(global[p]));
+        mat3 swi = matrixCompMult(local, mat3(sca,sca,sca));
+        vec3 ce = mix(world[i], world[p], .5f) + offset;
+        I << Instance{ swi, ce };
+    }
+}
+
+/// appends the instances in [first, last) that may shadow into the cascade
+static int cascadeInstances(vector<Instance> & I, int first, int last, Cascade const& cascade, vec3 sunDir)
+{
+    int n = 0;
+    for (int i=first; i<last; i++)
+    {
+        Instance inst = I[i];
+        float r = length(inst.rot[0]) + length(inst.rot[1]) + length(inst.rot[2]);
+        if (!CascadeOverlaps(cascade, sunDir, inst.pos, r)) continue;
+        I << inst;
+        n++;
+    }
+    return n;
+}
+
+/// texels per palette row and frame, keep in sync with draw.glsl
+static const int PaletteWidth = Joint_Max + 1;
+
+/// one row per character, 16 bytes per joint: the root's position as floats,
+/// then per joint the rotation as snorms and the position from the root as halves
+static void jointPalette(vector<uvec4> & P, vec3 const world[], quat const global[], vec3 offset)
+{
+    vec3 origin = world[Root] + offset;
+    P << uvec4(floatBitsToUint(origin), 0);
+    for (int i=0; i<Joint_Max; i++)
+    {
+        quat q = global[i];
+        vec3 t = world[i] + offset - origin;
+        P << uvec4(packSnorm2x16(vec2(q.x, q.y)), packSnorm2x16(vec2(q.z, q.w)),
+                   packHalf2x16(vec2(t.x, t.y)), packHalf2x16(vec2(t.z, 0)));
+    }
+}
+
+/// last frame's palette sits after the current one in every row, where the
+/// motion vectors read it
+static vector<uvec4> paletteHistory(vector<uvec4> const& P, vector<uvec4> const& prev)
+{
+    const int w = PaletteWidth;
+    vector<uvec4> R;
+    for (size_t row=0; row<P.size(); row+=w)
+    {
+        R.insert(R.end(), P.begin()+row, P.begin()+row+w);
+        R.insert(R.end(), prev.begin()+row, prev.begin()+row+w);
+    }
+    return R;
+}
+
+/// level of the skinned mesh seen from the camera, by the projected size the
+/// animation scheduler found
+static int cameraLod(float screenSize)
+{
+    return screenSize >= .25f ? 0 : screenSize >= .08f ? 1 : 2;
+}
+
+/// level of the skinned mesh in a cascade, by the shadow texels it covers
+static int shadowLod(Cascade const& cascade, float radius)
+{
+    float texels = radius / cascade.radius * CascadeSize;
+    return texels >= 64.f ? 0 : texels >= 16.f ? 1 : 2;
+}
+
+/// rows ahead of the characters, uploaded once: the bind pose, then the bone
+/// count and per bone its joint and parent joint, then half extents as halves
+static void staticPalette(vector<uvec4> & P)
+{
+    quat bind[Joint_Max];
+    for (quat & q : bind) q = quat(1,0,0,0);
+    jointPalette(P, joints, bind, vec3(0));
+
+    size_t row = P.size();
+    P << uvec4(0);
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!hasMesh[i]) continue;
+        vec3 sca = boneScale(i);
+        P << uvec4(i | parentTable[i] << 16, 0, packHalf2x16(vec2(sca.x, sca.y)), packHalf2x16(vec2(sca.z, 0)));
+    }
+    P[row].x = P.size() - row - 1;
+    P.resize(row + PaletteWidth, uvec4(0));
+}
+
+/// the bone shapes baked into one mesh in the bind pose, each vertex follows
+/// the joint driving its bone and blends into the neighbouring bones at the ends
+static void tSkinnedRig(vector<Vertex> & V, vector<Index> & F, vector<Skin> & S, int N)
+{
+    size_t baseVertex = V.size();
+    for (int i=0; i<Joint_Max; i++)
+    {
+        if (!hasMesh[i]) continue;
+
+        int p = parentTable[i];
+        int pp = parentTable[p];
+        vec3 sca = boneScale(i);
+        vec3 ce = mix(joints[i], joints[p], .5f);
+        vec3 bone = jointsLocal[i];
+
+        size_t firstVertex = V.size();
+        size_t firstIndex = F.size();
+        tCapsule(V, F, 0, N);
+        for (size_t k=firstIndex; k<F.size(); k++)
+        {
+            F[k] += firstVertex - baseVertex;
+        }
+        for (size_t k=firstVertex; k<V.size(); k++)
+        {
+            vec3 pos = V[k].pos * sca + ce;
+            vec3 nor = normalize(V[k].nor / sca);
+            float s = clamp(dot(pos - joints[p], bone) / dot(bone, bone), 0.f, 1.f);
+            int a = (.5f - .5f * smoothstep(0.f, .3f, s)) * 255.f + .5f;
+            int b = (.5f * smoothstep(.7f, 1.f, s)) * 255.f + .5f;
+            V[k] = { pos, nor };
+            S << Skin{ { (unsigned char)pp, (unsigned char)p, (unsigned char)i, 0 },
+                       { (unsigned char)a, (unsigned char)(255-a-b), (unsigned char)b, 0 } };
+        }
+    }
+}
+
 #include <glad/glad.h>
 #include <btBulletDynamicsCommon.h>
 #include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
@@ -132,7 +380,7 @@ void _init()
     btTypedConstraint *joint7 = new btGeneric6DofConstraint(rb, rb, x, x, false);
 }
 
-extern "C" ivec2 mainAnimation(float t, uint32_t iFrame, vec2 res, vec4 iMouse, btDynamicsWorld *dynamicWorld)
+extern "C" FrameInfo mainAnimation(float t, uint32_t iFrame, vec2 res, vec4 iMouse, btDynamicsWorld *dynamicWorld)
 {
     if (iFrame == 0)
     {
@@ -186,6 +434,22 @@ extern "C" ivec2 mainAnimation(float t, uint32_t iFrame, vec2 res, vec4 iMouse,
 
     dynamicWorld->stepSimulation(dt);
 
+    // particles spawn at the emitters of this frame, sparks where bodies hit
+    // hard, dust under the feet further down
+    vector<Emitter> E;
+    btDispatcher *dispatcher = dynamicWorld->getDispatcher();
+    for (int i=0; i<dispatcher->getNumManifolds(); i++)
+    {
+        btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(i);
+        for (int k=0; k<manifold->getNumContacts(); k++)
+        {
+            btManifoldPoint const& pt = manifold->getContactPoint(k);
+            if (pt.getAppliedImpulse() < .5f) continue;
+            btVector3 p = pt.getPositionWorldOnB(), n = pt.m_normalWorldOnB;
+            E << Emitter{ (vec3&)p, .05f, (vec3&)n * 3.f, 2.f, pt.getAppliedImpulse() * 2000.f, .8f, .01f, 0 };
+        }
+    }
+
     vector<vec3> U;
     btCollisionObjectArray const& arr = dynamicWorld->getCollisionObjectArray();
     for (int i=0; i<arr.size(); i++)
@@ -222,97 +486,450 @@ extern "C" ivec2 mainAnimation(float t, uint32_t iFrame, vec2 res, vec4 iMouse,
     vec2 m = (vec2&)iMouse / res * float(M_PI) * 2.0f + 1.13f;
     vec3 ro = ta + vec3(sin(m.x),.5,cos(m.x)) * 2.5f;
 
-    vector<Instance> I;
+    // static scenery goes first, its shadow is cached until it changes
+    static vector<Instance> scenery;
+    static int sceneryVersion = 0;
+    if (scenery.empty())
+    { // pillars around the crowd
+        for (int i=0; i<12; i++)
+        {
+            float a = i * float(M_PI) / 6.f;
+            scenery << Instance{ mat3(.25f, 0, 0, 0, 1.5f, 0, 0, 0, .25f), vec3(sin(a), 0, cos(a)) * 5.5f + vec3(0,1.5f,0) };
+        }
+        sceneryVersion++;
+    }
+    vector<Instance> I(scenery.begin(), scenery.end());
+
+    // -------------------------------SDF--------------------------------//
 
-    extern const IkRig parentTable[];
-    extern const bool hasMesh[];
-    extern const vector<vec3> jointsLocal;
+    FrameInfo info = {};
+    info.sdfLo = vec3(1), info.sdfHi = vec3(0);
 
-    vector<vec3> world(Joint_Max, vec3(0));
-    vector<mat3> local(Joint_Max, mat3(1));
+    static SdfScene sdf;
+    if (sdf._primitives.empty())
+    { // rocks and rings scattered around the crowd, melting into the ground
+        for (int i=0; i<200; i++)
+        {
+            float a = hash11(i*3.1f) * 2.f*M_PI;
+            float r = mix(7.f, 14.f, hash11(i*7.7f));
+            float s = mix(.2f, .5f, hash11(i*1.3f));
+            SdfPrimitive p;
+            p.type = SdfType(i % 3);
+            p.rot = rotateY(a) * rotateX((hash11(i*5.9f) - .5f) * float(M_PI));
+            p.pos = vec3(sin(a)*r, s*.6f, cos(a)*r);
+            p.params = p.type == SdfSphere ? vec4(s)
+                : p.type == SdfBox ? vec4(vec3(s*.8f), .05f)
+                : vec4(s, s*.3f, 0, 0);
+            p.blend = .2f;
+            p.material = 2 + i % 3;
+            sdf.Add(p);
+        }
+        sdf.Bounds(&info.sdfLo, &info.sdfHi);
+    }
+    sdf.Cull(ro, ta, 1.2f, res);
 
-    for (int i=Hips; i<Joint_Max; i++)
+    // ------------------------------Lights------------------------------//
+
+    static LightGrid lights;
+    static const int Flashes = 48;
+    if (lights._lights.empty())
+    { // flashes among the crowd, lamps scattered over the ground, a spot over every pillar
+        for (int i=0; i<Flashes; i++)
+        {
+            vec3 pos = vec3((hash11(i*2.3f) - .5f) * 12.f, 1.2f, -hash11(i*4.1f) * 20.f);
+            lights.Add(Light{ pos, 2.f, vec3(0), vec3(0), -1.f });
+        }
+        for (int i=0; i<240; i++)
+        {
+            float a = hash11(i*6.7f) * 2.f*M_PI;
+            float r = mix(3.f, 20.f, hash11(i*8.3f));
+            vec3 color = normalize(vec3(hash11(i*1.1f), hash11(i*2.9f), hash11(i*3.7f)) + .2f);
+            lights.Add(Light{ vec3(sin(a)*r, .4f, cos(a)*r), mix(1.5f, 3.f, hash11(i*9.1f)), color, vec3(0), -1.f });
+        }
+        for (Instance const& pillar : scenery)
+        {
+            lights.Add(Light{ pillar.pos + vec3(0,3,0), 6.f, vec3(1.,.9f,.7f) * 2.f, vec3(0,-1,0), cos(.5f) });
+        }
+    }
+    for (int i=0; i<Flashes; i++)
+    { // every flash fires for a few frames once in a while
+        float fire = fract(t * 1.5f + hash11(i*5.3f)) < .05f;
+        lights._lights[i].color = vec3(4.f, 2.5f, 1.f) * fire;
+    }
+    lights.Cull(ro, ta, 1.2f, res);
+
+    // ----------------------------Animation-----------------------------//
+
+    static PosePool pool;
+    static BlendTree tree;
+    static MotionDatabase db;
+    static AnimScheduler scheduler;
+    static vector<Character> crowd;
+    static int idle, walk, wave, locomotion, waveLayer;
+    if (tree._nodes.empty())
     {
-        int p = parentTable[i];
-        world[i] = world[p] + jointsLocal[i] * local[p];
-        local[i] *= local[p];
+        idle = tree.AddClip(clipIdle);
+        walk = tree.AddClip(clipWalk);
+        wave = tree.AddClip(clipWave);
+        locomotion = tree.AddLerp(idle, walk, 0);
+        tree.PushLayer(locomotion, 1, MaskAll);
+        waveLayer = tree.PushLayer(wave, 0, MaskChain(Shoulder_R, Hand_R));
+
+        db.AddClip(clipIdle, NULL, M_PI);
+        db.AddClip(clipWalk, NULL, 1);
+        db.Build();
+
+        for (int i=0; i<CrowdSize; i++)
+        {
+            // the first character stands at the origin, the rest queue up behind
+            vec3 pos = i == 0 ? vec3(0) : vec3(((i-1)%6 - 2.5f) * 2.f, 0, -4.f - (i-1)/6 * 4.f);
+            Character c;
+            c.pos = pos;
+            c.lastTime = t;
+            c.matcher.phase = i;
+            crowd.push_back(c);
+            scheduler.Add(pos + vec3(0,1,0), 1.f);
+        }
     }
 
-    for (int i=0; i<Joint_Max; i++)
+    vector<int> update;
+    scheduler.Schedule(ro, ta, 1.2f, res, iFrame, update);
+    for (int i : update)
     {
-        if (!hasMesh[i]) continue;
+        Character & c = crowd[i];
+        float elapsed = t - c.lastTime;
+        c.lastTime = t;
 
-        int p = parentTable[i];
-        float w = .2 + hash11(i + 349) * .1;
-            w *= 1 - (i>Shoulder_R || p == Neck) * .5;
-        float r = length(jointsLocal[i]);
-        mat3 rot = rotationAlign(jointsLocal[i]/r, vec3(0,0,1));
-        vec3 sca = abs(rot * vec3(w,w,r)) * .5f;
-
-        mat3 swi = matrixCompMult(local[i], mat3(sca,sca,sca));
-        vec3 ce = mix(world[i], world[p], .5f);
-        I << Instance{ swi, ce };
+        { // locomotion, the desired trajectory speeds up and slows down over time
+            float speed = WalkSpeed * smoothstep(-.5f, .5f, sin(t * .3f + i));
+            vec2 trajPos[TrajectoryPoints], trajDir[TrajectoryPoints];
+            for (int k=0; k<TrajectoryPoints; k++)
+            {
+                trajPos[k] = vec2(0, speed * (k+1.f)/TrajectoryPoints);
+                trajDir[k] = vec2(0, 1);
+            }
+            c.matcher.Update(db, iFrame, elapsed, trajPos, trajDir);
+
+            // the clip fading out carries on from where this character left it
+            int playing = c.matcher.clip;
+            c.clipTime[playing] = c.matcher.time;
+            c.clipTime[playing ^ 1] += elapsed;
+            c.locomotion = clamp(c.locomotion + (playing == 1 ? elapsed : -elapsed) * 4.f, 0.f, 1.f);
+            tree._nodes[idle].time = c.clipTime[0];
+            tree._nodes[walk].time = c.clipTime[1];
+            tree._nodes[locomotion].weight = c.locomotion;
+        }
+        tree._nodes[wave].time = t;
+        tree._nodes[waveLayer].weight = i == 0 ? iMouse.z : 0.;
+
+        // root motion is dropped, the character animates in place
+        Pose *pose = pool.Acquire();
+        tree.Evaluate(pool, pose, MaskAll & ~JOINT_BIT(Root));
+        BindPose(pose, JOINT_BIT(Root));
+        scheduler.Commit(i, iFrame, *pose);
+        pool.Release(pose);
     }
 
-    void loadBuffers(vector<vec3> const& U, vector<Instance> const& I);
-    loadBuffers(U, I);
+    vector<uvec4> P;
+    for (int i=0; i<CrowdSize; i++)
+    {
+        Pose pose;
+        vec3 world[Joint_Max];
+        quat global[Joint_Max];
+        scheduler.Sample(i, iFrame, &pose);
+        PoseToWorld(pose, world, global);
+        if (characterMode != DrawBones)
+        {
+            jointPalette(P, world, global, crowd[i].pos);
+        }
+        else
+        {
+            boneInstances(I, world, global, crowd[i].pos);
+        }
+        for (int toe : { Toe_L, Toe_R })
+        {
+            vec3 pos = world[toe] + crowd[i].pos;
+            if (pos.y < .08f) E << Emitter{ pos, .05f, vec3(0,.6f,0), .4f, 60.f, 1.5f, .015f, 0 };
+        }
+    }
+
+    // ------------------------------Shadow------------------------------//
+
+    const vec3 sunDir = normalize(vec3(1,2,3));
+    Cascade cascades[CascadeCount];
+    FitCascades(ro, ta, 1.2f, res, sunDir, 60.f, cascades);
+
+    ShadowBlock S;
+    for (int k=0; k<CascadeCount; k++)
+    {
+        S.cascade[k] = cascades[k].viewProj;
+        S.splits[k] = cascades[k].split;
+    }
+
+    // the camera draws everything, a cascade only what may shadow into it,
+    // skinned draws find their palette row through a draw id per instance
+    int bones = 0;
+    for (int i=0; i<Joint_Max; i++) bones += hasMesh[i];
+    const int rigid = I.size();
+    const int characters = P.size() / PaletteWidth;
+
+    const int statics = scenery.size();
+
+    vector<DrawGroup> G;
+    vector<uint> D;
+    for (int k=-1; k<CascadeCount; k++)
+    {
+        DrawGroup g = { 0, rigid };
+        if (k >= 0)
+        {
+            g.firstInstance = I.size();
+            g.instances = cascadeInstances(I, statics, rigid, cascades[k], sunDir);
+        }
+
+        vector<int> visible;
+        for (int c=0; c<characters; c++)
+        {
+            if (k < 0 || CascadeOverlaps(cascades[k], sunDir, crowd[c].pos + vec3(0,1,0), 1.f))
+            {
+                visible.push_back(c);
+            }
+        }
+        for (int l=0; l<SkinLods; l++)
+        {
+            g.firstSkinned[l] = D.size();
+            if (characterMode != DrawSkinned) continue;
+            for (int c : visible)
+            {
+                int lod = k < 0 ? cameraLod(scheduler._characters[c].screenSize) : shadowLod(cascades[k], 1.f);
+                if (lod == l) D << (uint)c;
+            }
+            g.skinned[l] = D.size() - g.firstSkinned[l];
+        }
+        g.firstJoint = D.size();
+        if (characterMode == DrawJoints)
+        {
+            for (int c : visible)
+            for (int b=0; b<bones; b++) D << (uint)(c*bones + b);
+        }
+        g.joints = D.size() - g.firstJoint;
+        G << g;
+    }
+
+    // then the static groups, redrawn only when the sun turned, the scenery
+    // changed or their cascade moved along the light or grew; a cascade
+    // moving across the light by whole texels scrolls what it cached instead,
+    // as the orthographic depth of a caster does not change with it
+    static Cascade cached[CascadeCount];
+    static vec3 cachedSun;
+    static int cachedVersion;
+    for (int k=0; k<CascadeCount; k++)
+    {
+        DrawGroup g = {};
+        g.firstInstance = I.size();
+        g.instances = cascadeInstances(I, 0, statics, cascades[k], sunDir);
+        for (int l=0; l<SkinLods; l++) g.firstSkinned[l] = D.size();
+        g.firstJoint = D.size();
+        G << g;
+
+        const float texel = 2.f*cascades[k].radius / CascadeSize;
+        ivec2 scroll = ivec2(round((vec2(cascades[k].center) - vec2(cached[k].center)) / texel));
+        if (cached[k].center.z != cascades[k].center.z || cached[k].radius != cascades[k].radius
+            || cachedSun != sunDir || cachedVersion != sceneryVersion
+            || abs(scroll.x) >= CascadeSize || abs(scroll.y) >= CascadeSize)
+        {
+            info.staticDirty |= 1 << k;
+        }
+        else
+        {
+            info.staticScroll[k] = scroll;
+        }
+        cached[k] = cascades[k];
+    }
+    cachedSun = sunDir;
+    cachedVersion = sceneryVersion;
+
+    // ------------------------------Motion------------------------------//
+
+    // last frame's transforms, matched by index as the camera's instances
+    // keep their order; anything new starts at rest
+    static vector<Instance> prevI;
+    static vector<uvec4> prevP;
+    static vec3 prevRo = ro, prevTa = ta;
+    vector<Instance> Q(I.begin(), I.begin() + rigid);
+    std::copy_n(prevI.begin(), min(prevI.size(), (size_t)rigid), Q.begin());
+    prevI.assign(I.begin(), I.begin() + rigid);
+    if (prevP.size() != P.size()) prevP = P;
+    vector<uvec4> R = paletteHistory(P, prevP);
+    prevP = P;
+
+    void loadBuffers(vector<vec3> const& U, vector<Instance> const& I, vector<Instance> const& Q,
+                     vector<uvec4> const& P, vector<uint> const& D, vector<DrawGroup> const& G,
+                     ShadowBlock const& S, FrameInfo & info);
+    void loadEmitters(vector<Emitter> const& E, float dt);
+    loadEmitters(E, dt);
+    loadBuffers(U, I, Q, R, D, G, S, info);
+    void loadPrimitives(SdfScene const& sdf);
+    loadPrimitives(sdf);
+    void loadLights(LightGrid const& lights);
+    loadLights(lights);
     const float data[] = {
         res.x,res.y, t, 0,
         ro.x,ro.y,ro.z, 0,
         ta.x,ta.y,ta.z, 0,
+        prevRo.x,prevRo.y,prevRo.z, 0,
+        prevTa.x,prevTa.y,prevTa.z, 0,
     };
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof data, data);
-    return ivec2(1, U.size());
+    prevRo = ro, prevTa = ta;
+
+    // rigid commands, gizmo vertices, then the commands reading the joint
+    // palette: skinned meshes followed by bones rebuilt from joints
+    info.count = ivec4(1, U.size(), 2, SkinLods+1);
+    info.cascades = CascadeCount;
+    info.groupCommands = 3 + SkinLods;
+    info.skinLods = SkinLods;
+    return info;
 }
 
-void loadBuffers(vector<vec3> const& U, vector<Instance> const& I)
+/// fills in the bytes per index and the vertex array of the cascades
+void loadBuffers(vector<vec3> const& U, vector<Instance> const& I, vector<Instance> const& Q,
+                 vector<uvec4> const& P, vector<uint> const& D, vector<DrawGroup> const& G,
+                 ShadowBlock const& S, FrameInfo & info)
 {
-    static vector<Command> C;
-    static GLuint vao, vbo1, vbo2, ibo, ebo, ubo, cbo, frame;
+    static vector<Command> T;
+    static vector<Meshlet> M;
+    static vector<ivec2> meshlets;  // first meshlet and count per template command
+    static vector<uvec4> P0;
+    static GLuint vao, vao2, vbo1, vbo2, vbo3, vbo4, ibo, ibo2, ibo3, ebo, ubo, cbo, dbo, tex, frame;
+    static GLint shadowOffset, meshOffset;
+    static int indexSize;
     if (!frame++)
     {
         vector<Vertex> V;
+        vector<PackedVertex> W;
         vector<Index> F;
+        vector<Skin> skin;
+        MeshBlock B = {};
 
+        // every mesh is regrouped into meshlets as it is added, its command
+        // spans all of them; skinned meshlets are bounded in the bind pose.
+        // The buffer holds the quantized copy, each mesh on its own box
         uint firstIndex = 0;
         uint baseVertex = 0;
+        auto addMesh = [&]()
+        {
+            ivec2 range = ivec2(M.size(), 0);
+            float acmr = MeshACMR(F, firstIndex, F.size());
+            BuildMeshlets(V, F, firstIndex, F.size(), baseVertex, M);
+            range.y = M.size() - range.x;
+            meshlets << range;
+            // triangles for the vertex cache within their meshlet, meshlets
+            // against overdraw, vertices in the order they are fetched; none
+            // of it changes what a meshlet bounds
+            for (int m=range.x; m<range.x+range.y; m++)
+            {
+                OptimizeVertexCache(F, M[m].firstIndex, M[m].firstIndex + M[m].indexCount);
+            }
+            OptimizeOverdraw(F, &M[range.x], range.y);
+            OptimizeVertexFetch(V, skin, F, firstIndex, F.size(), baseVertex);
+            printf("INFO: mesh %d, %d triangles, ACMR %.3f -> %.3f\n", (int)T.size(),
+                   (int)(F.size()-firstIndex)/3, acmr, MeshACMR(F, firstIndex, F.size()));
+            // a box per mesh in the MESHES block, and the mesh index in 16 bits
+            assert(T.size() + 1 <= MaxMeshes);
+            PackVertices(V, baseVertex, T.size(), B.box[T.size()], W);
+            T << Command{ (uint)F.size()-firstIndex, 0, firstIndex, baseVertex, 0 };
+            firstIndex = F.size();
+            baseVertex = V.size();
+        };
         tCubeMap(V, F, 2);
-        C << Command{ (uint)F.size()-firstIndex, 0, firstIndex, baseVertex, 0 };
-        firstIndex = F.size();
-        baseVertex = V.size();
+        addMesh();
         tCapsule(V, F, 0);
-        C << Command{ (uint)F.size()-firstIndex, 0, firstIndex, baseVertex, 0 };
-        firstIndex = F.size();
-        baseVertex = V.size();
+        addMesh();
+        for (int l=0; l<SkinLods; l++)
+        { // the skinned mesh, every level after the other
+            skin.resize(V.size(), Skin{});
+            tSkinnedRig(V, F, skin, SkinLodDetail[l]);
+            addMesh();
+        }
+        Command bones = T[0];
+        T << bones;
+        meshlets << meshlets[0];
 
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
 
         glGenBuffers(1, &vbo1);
         glGenBuffers(1, &vbo2);
+        glGenBuffers(1, &vbo3);
+        glGenBuffers(1, &vbo4);
         glGenBuffers(1, &ubo);
         glGenBuffers(1, &ebo);
         glGenBuffers(1, &cbo);
+        glGenBuffers(1, &dbo);
         glGenBuffers(1, &ibo);
+        glGenBuffers(1, &ibo2);
+        glGenBuffers(1, &ibo3);
 
+        // INPUT, SHADOW then MESHES, each on its own binding
+        GLint align;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+        shadowOffset = (80 + align-1) / align * align;
+        meshOffset = (shadowOffset + sizeof(ShadowBlock) + align-1) / align * align;
         glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-        glBufferData(GL_UNIFORM_BUFFER, 64, NULL, GL_DYNAMIC_DRAW);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, meshOffset + sizeof B, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, meshOffset, sizeof B, &B);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, 0, 80);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 1, ubo, shadowOffset, sizeof(ShadowBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, 2, ubo, meshOffset, sizeof B);
 
+        // indices are relative to their mesh's base vertex, 16 bit ones do
+        // while no mesh outgrows them
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, F.size() * sizeof F[0], F.data(), GL_STATIC_DRAW);
+        if (*std::max_element(F.begin(), F.end()) <= 0xffff)
+        {
+            vector<unsigned short> F16(F.begin(), F.end());
+            indexSize = sizeof F16[0];
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, F16.size() * indexSize, F16.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexSize = sizeof F[0];
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, F.size() * indexSize, F.data(), GL_STATIC_DRAW);
+        }
 
+        // the grid and mesh index come in unnormalized, the shader decodes them
         glBindBuffer(GL_ARRAY_BUFFER, vbo1);
-        glBufferData(GL_ARRAY_BUFFER, V.size() * sizeof V[0], V.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, W.size() * sizeof W[0], W.data(), GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), 0);
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)12);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)8);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo3);
+        glBufferData(GL_ARRAY_BUFFER, skin.size() * sizeof skin[0], skin.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(Skin), 0);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Skin), (void*)4);
 
         glBindBuffer(GL_ARRAY_BUFFER, vbo2);
         glEnableVertexAttribArray(8);
         glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, 12, 0);
 
+        glBindBuffer(GL_ARRAY_BUFFER, vbo4);
+        glEnableVertexAttribArray(9);
+        glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(uint), 0);
+        glVertexAttribDivisor(9, 1);
+
+        glGenTextures(1, &tex);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        staticPalette(P0);
+        P0 = paletteHistory(P0, P0);
+
         glBindBuffer(GL_ARRAY_BUFFER, ibo);
         for (size_t off=0, i=4; i<8; i++, off+=12)
         {
@@ -320,9 +937,67 @@ void loadBuffers(vector<vec3> const& U, vector<Instance> const& I)
             glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)off);
             glVertexAttribDivisor(i, 1);
         }
+        glBindBuffer(GL_ARRAY_BUFFER, ibo2);
+        for (size_t off=0, i=10; i<14; i++, off+=12)
+        {
+            glEnableVertexAttribArray(i);
+            glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)off);
+            glVertexAttribDivisor(i, 1);
+        }
+
+        // the cascades' own vertex array: the cascade commands' base instances
+        // lie past the camera's instances, so it takes the packed instances
+        // in their place rather than besides them
+        glGenVertexArrays(1, &vao2);
+        glBindVertexArray(vao2);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo1);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), 0);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo3);
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(Skin), 0);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Skin), (void*)4);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo4);
+        glEnableVertexAttribArray(9);
+        glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(uint), 0);
+        glVertexAttribDivisor(9, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, ibo3);
+        glEnableVertexAttribArray(14);
+        glVertexAttribIPointer(14, 4, GL_UNSIGNED_INT, sizeof(PackedInstance), 0);
+        glVertexAttribDivisor(14, 1);
+        glEnableVertexAttribArray(15);
+        glVertexAttribPointer(15, 3, GL_FLOAT, GL_FALSE, sizeof(PackedInstance), (void*)16);
+        glVertexAttribDivisor(15, 1);
+        glBindVertexArray(vao);
     }
 
-    C[0].instanceCount = I.size();
+    // the same commands per group, the camera's then every cascade's: rigid,
+    // capsule, the skinned levels of detail and the joints; each with what
+    // a pulling vertex stage reads in place of the instanced attributes
+    vector<Command> C;
+    vector<DrawInfo> A;
+    for (DrawGroup const& g : G)
+    {
+        Command rigid = T[0], joints = T[2+SkinLods];
+        rigid.instanceCount = g.instances;
+        rigid.baseInstance = g.firstInstance;
+        C << rigid, T[1];
+        A << DrawInfo{ 0, (uint)g.firstInstance }, DrawInfo{ 0, 0 };
+        for (int l=0; l<SkinLods; l++)
+        {
+            Command skinned = T[2+l];
+            skinned.instanceCount = g.skinned[l];
+            skinned.baseInstance = g.firstSkinned[l];
+            C << skinned;
+            A << DrawInfo{ 1, (uint)g.firstSkinned[l] };
+        }
+        joints.instanceCount = g.joints;
+        joints.baseInstance = g.firstJoint;
+        C << joints;
+        A << DrawInfo{ 2, (uint)g.firstJoint };
+    }
 
     { // command buffer
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cbo);
@@ -338,17 +1013,31 @@ void loadBuffers(vector<vec3> const& U, vector<Instance> const& I)
             glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, newSize, C.data());
         }
     }
+    { // draw infos, storage binding 0
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, dbo);
+        int oldSize;
+        glGetBufferParameteriv(GL_SHADER_STORAGE_BUFFER, GL_BUFFER_SIZE, &oldSize);
+        int newSize = A.size() * sizeof A[0];
+        if (oldSize < newSize)
+        {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, newSize, A.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, newSize, A.data());
+        }
+    }
     { // index buffer
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     }
     { // channel 0 1
         glBindBuffer(GL_ARRAY_BUFFER, vbo1);
     }
-    { // channel 4 5 6 7
+    { // channel 4 5 6 7, only the camera's instances, as many as last frame's
         glBindBuffer(GL_ARRAY_BUFFER, ibo);
         int oldSize;
         glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &oldSize);
-        int newSize = I.size() * sizeof I[0];
+        int newSize = Q.size() * sizeof I[0];
         if (oldSize < newSize)
         {
             glBufferData(GL_ARRAY_BUFFER, newSize, I.data(), GL_DYNAMIC_DRAW);
@@ -358,6 +1047,79 @@ void loadBuffers(vector<vec3> const& U, vector<Instance> const& I)
             glBufferSubData(GL_ARRAY_BUFFER, 0, newSize, I.data());
         }
     }
+    { // channel 10 11 12 13, last frame's instances
+        glBindBuffer(GL_ARRAY_BUFFER, ibo2);
+        int oldSize;
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &oldSize);
+        int newSize = Q.size() * sizeof Q[0];
+        if (oldSize < newSize)
+        {
+            glBufferData(GL_ARRAY_BUFFER, newSize, Q.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, newSize, Q.data());
+        }
+    }
+    { // channel 14 15, every instance packed, the shadow cascades' only exist here
+        vector<PackedInstance> K;
+        for (Instance const& inst : I) K << packInstance(inst);
+        glBindBuffer(GL_ARRAY_BUFFER, ibo3);
+        int oldSize;
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &oldSize);
+        int newSize = K.size() * sizeof K[0];
+        if (oldSize < newSize)
+        {
+            glBufferData(GL_ARRAY_BUFFER, newSize, K.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, newSize, K.data());
+        }
+    }
+    { // joint palette, texture unit 4
+        const int w = PaletteWidth*2, h0 = P0.size() / w, h = P.size() / w;
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        int oldHeight;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &oldHeight);
+        if (oldHeight < h0 + h)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, w, h0 + h, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, NULL);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, P0.data());
+        }
+        if (h)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, h0, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT, P.data());
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+    { // channel 9, draw ids
+        glBindBuffer(GL_ARRAY_BUFFER, vbo4);
+        int oldSize;
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &oldSize);
+        int newSize = D.size() * sizeof D[0];
+        if (oldSize < newSize)
+        {
+            glBufferData(GL_ARRAY_BUFFER, newSize, D.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, newSize, D.data());
+        }
+    }
+    { // the instance buffers again as storage 1 to 4 for the pulling vertex
+      // stages: the camera's, last frame's, every one packed, the draw ids
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, dbo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ibo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ibo2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ibo3);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, vbo4);
+    }
+    { // shadow cascades
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, shadowOffset, sizeof(ShadowBlock), &S);
+    }
     { // channel 8
         glBindBuffer(GL_ARRAY_BUFFER, vbo2);
         int oldSize;
@@ -372,4 +1134,132 @@ void loadBuffers(vector<vec3> const& U, vector<Instance> const& I)
             glBufferSubData(GL_ARRAY_BUFFER, 0, newSize, U.data());
         }
     }
+    info.indexSize = indexSize;
+    info.shadowVao = vao2;
+}
+
+void loadEmitters(vector<Emitter> const& E, float dt)
+{
+    static GLuint ubo;
+    if (!ubo)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(EmitterBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 3, ubo);
+    }
+
+    { // the EMITTERS block, binding 3
+        static EmitterBlock B;
+        B.count = min((int)E.size(), (int)MaxEmitters);
+        B.dt = dt;
+        std::copy_n(E.begin(), B.count, B.emitter);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof B, &B);
+    }
+}
+
+void loadPrimitives(SdfScene const& sdf)
+{
+    static GLuint tex1, tex2;
+    static int tex2Rows;
+    const int stride = SdfMaxPrimitives+1, rows = 1 + sdf._tilesX*sdf._tilesY;
+    if (!tex1)
+    {
+        glGenTextures(1, &tex1);
+        glActiveTexture(GL_TEXTURE9);
+        glBindTexture(GL_TEXTURE_2D, tex1);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, SdfTexels, SdfMaxPrimitives);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    if (tex2Rows < rows)
+    { // the tiles follow the view size, immutable storage is made anew
+        glDeleteTextures(1, &tex2);
+        glGenTextures(1, &tex2);
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_2D, tex2);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16I, stride, rows);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        tex2Rows = rows;
+    }
+
+    { // primitives, texture unit 9
+        vector<vec4> T;
+        sdf.Texels(T);
+        glActiveTexture(GL_TEXTURE9);
+        glBindTexture(GL_TEXTURE_2D, tex1);
+        if (T.size())
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SdfTexels, T.size() / SdfTexels, GL_RGBA, GL_FLOAT, T.data());
+        }
+    }
+    { // tile lists, texture unit 10, only the columns in use
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_2D, tex2);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sdf._primitives.size()+1, rows, GL_RED_INTEGER, GL_SHORT, sdf._lists.data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void loadLights(LightGrid const& lights)
+{
+    static GLuint tex1, tex2, tex3;
+    const int rows = LightMaxIndices / LightIndexWidth;
+    if (!tex1)
+    {
+        glGenTextures(1, &tex1);
+        glActiveTexture(GL_TEXTURE12);
+        glBindTexture(GL_TEXTURE_2D, tex1);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, LightTexels, LightMaxLights);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &tex2);
+        glActiveTexture(GL_TEXTURE13);
+        glBindTexture(GL_TEXTURE_2D, tex2);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32I, ClusterX*ClusterY, ClusterZ);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &tex3);
+        glActiveTexture(GL_TEXTURE14);
+        glBindTexture(GL_TEXTURE_2D, tex3);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16I, LightIndexWidth, rows);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    { // lights, texture unit 12
+        vector<vec4> T;
+        lights.Texels(T);
+        glActiveTexture(GL_TEXTURE12);
+        glBindTexture(GL_TEXTURE_2D, tex1);
+        if (T.size())
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LightTexels, T.size() / LightTexels, GL_RGBA, GL_FLOAT, T.data());
+        }
+    }
+    { // froxels, texture unit 13
+        glActiveTexture(GL_TEXTURE13);
+        glBindTexture(GL_TEXTURE_2D, tex2);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ClusterX*ClusterY, ClusterZ, GL_RG_INTEGER, GL_INT, lights._clusters.data());
+    }
+    { // light indices, texture unit 14, only the rows in use
+        vector<short> F = lights._indices;
+        F.resize((F.size() + LightIndexWidth-1) / LightIndexWidth * LightIndexWidth, 0);
+        glActiveTexture(GL_TEXTURE14);
+        glBindTexture(GL_TEXTURE_2D, tex3);
+        if (F.size())
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LightIndexWidth, F.size() / LightIndexWidth, GL_RED_INTEGER, GL_SHORT, F.data());
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
 }
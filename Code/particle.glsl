@@ -0,0 +1,86 @@
+#version 300 es
+precision highp float;
+
+layout (std140) uniform INPUT {
+    vec2 iResolution; float iTime, _pad1;
+    vec3 _ro; float _fov;
+    vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
+};
+
+// keep in sync with module.cpp and particles.h
+const int MaxEmitters = 64;
+const int ParticleCount = 1 << 15;
+layout (std140) uniform EMITTERS {
+    int iEmitters;
+    float iDelta;                   // seconds since the last frame
+    vec4 iEmitter[MaxEmitters*3];   // spawn sphere, velocity and spread, rate, life and radius
+};
+
+#ifdef _VS
+layout (location = 0) in vec4 aPosition;    // radius in w
+layout (location = 1) in vec4 aVelocity;    // seconds left in w, dead at 0
+out vec4 tfPosition;
+out vec4 tfVelocity;
+
+/// @link https://nullprogram.com/blog/2018/07/31/
+uint hash(uint x)
+{
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random(inout uint seed)
+{
+    seed = hash(seed);
+    return float(seed >> 8) / 16777216.;
+}
+
+vec3 randomDir(inout uint seed)
+{
+    float z = random(seed) * 2. - 1., a = random(seed) * 6.2831853;
+    return vec3(sqrt(1. - z*z) * vec2(cos(a), sin(a)), z);
+}
+
+void main()
+{
+    vec4 p = aPosition, v = aVelocity;
+    if (v.w > 0.)
+    { // falls, slows down in the air and bounces off the ground
+        v.xyz += vec3(0, -9.8, 0) * iDelta;
+        v.xyz *= exp(-1.5 * iDelta);
+        p.xyz += v.xyz * iDelta;
+        if (p.y < p.w)
+        {
+            p.y = p.w;
+            v.xyz *= vec3(.6, -.3, .6);
+        }
+        v.w = max(v.w - iDelta, 0.);
+    }
+    else if (iEmitters > 0)
+    { // a free particle picks an emitter, and spawns as often as its rate
+      // would ask if every particle were free
+        uint seed = hash(uint(gl_VertexID) ^ hash(floatBitsToUint(iTime)));
+        int e = min(int(random(seed) * float(iEmitters)), iEmitters-1);
+        vec4 a = iEmitter[e*3], b = iEmitter[e*3+1], c = iEmitter[e*3+2];
+        if (random(seed) < c.x * iDelta * float(iEmitters) / float(ParticleCount))
+        {
+            p = vec4(a.xyz + randomDir(seed) * a.w * random(seed), c.z);
+            v = vec4(b.xyz + randomDir(seed) * b.w, c.y * mix(.5, 1., random(seed)));
+        }
+    }
+    tfPosition = p;
+    tfVelocity = v;
+    gl_Position = vec4(0);
+}
+#else
+// never runs, the rasterizer is off while the particles advance
+out vec4 fragColor;
+void main()
+{
+    fragColor = vec4(0);
+}
+#endif
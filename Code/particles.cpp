@@ -0,0 +1,64 @@
+#include "particles.h"
+
+void ParticleSystem::Init()
+{
+    // every particle starts dead, with no time left
+    vector<vec4> zero(ParticleCount*2, vec4(0));
+    GLint vao;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+
+    glGenBuffers(2, _buffers);
+    glGenVertexArrays(2, _simulate);
+    glGenVertexArrays(2, _render);
+    for (int i=0; i<2; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, zero.size() * sizeof zero[0], zero.data(), GL_DYNAMIC_COPY);
+        for (int k=0; k<2; k++)
+        {
+            glBindVertexArray(k == 0 ? _simulate[i] : _render[i]);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 32, 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 32, (void*)16);
+            glVertexAttribDivisor(0, k);
+            glVertexAttribDivisor(1, k);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(vao);
+}
+
+GLuint ParticleSystem::CreateProgram()
+{
+    static const char *varyings[] = { "tfPosition", "tfVelocity" };
+    GLuint prog = glCreateProgram();
+    glTransformFeedbackVaryings(prog, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+    return prog;
+}
+
+void ParticleSystem::Simulate()
+{
+    // the module's vertex array stays bound for everyone else
+    GLint vao;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glBindVertexArray(_simulate[_current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, _buffers[_current ^ 1]);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, ParticleCount);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(vao);
+    _current ^= 1;
+}
+
+void ParticleSystem::Draw()
+{
+    GLint vao;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glBindVertexArray(_render[_current]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, ParticleCount);
+    glBindVertexArray(vao);
+}
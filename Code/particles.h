@@ -0,0 +1,33 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+#include "common.h"
+#include <glad/glad.h>
+
+// keep in sync with particle.glsl and splat.glsl
+enum {
+    ParticleCount = 1 << 15,
+};
+
+/// particles that never leave the GPU: two buffers of position and radius,
+/// velocity and seconds left, every frame's state fed back from the last's
+/// through transform feedback. The module only uploads the emitters
+struct ParticleSystem
+{
+    GLuint _buffers[2];
+    GLuint _simulate[2];    // vertex arrays reading either buffer per vertex
+    GLuint _render[2];      // and per instance
+    int _current = 0;
+
+    void Init();
+
+    /// program whose vertex stage writes the particles back, before it is linked
+    GLuint CreateProgram();
+
+    /// advances every particle into the other buffer with the bound program
+    void Simulate();
+
+    /// a quad per particle with the bound program, the dead ones collapse
+    void Draw();
+};
+
+#endif // PARTICLES_H
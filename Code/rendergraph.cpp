@@ -0,0 +1,372 @@
+#include "rendergraph.h"
+#include <stdio.h>
+#include <algorithm>
+
+void GlState::Reset()
+{
+    _depthTest = _cullFace = _blend = _depthMask = Unknown;
+    _depthFunc = _frontFace = _blendSrc = _blendDst = Unknown;
+    _framebuffer = _program = Unknown;
+    for (int i=0; i<DrawBuffers; i++)
+    {
+        _bufferSrc[i] = _bufferDst[i] = Unknown;
+    }
+    _viewport = ivec4(Unknown);
+    ForgetTextures();
+}
+
+void GlState::ForgetTextures()
+{
+    _activeUnit = Unknown;
+    for (int i=0; i<Units; i++)
+    {
+        _target[i] = _texture[i] = Unknown;
+    }
+}
+
+// true when the call has to go through, the cached value is updated
+static bool changed(GlState *state, int & cached, int value)
+{
+    state->_calls++;
+    if (cached == value)
+    {
+        state->_skipped++;
+        return false;
+    }
+    cached = value;
+    return true;
+}
+
+void GlState::Enable(GLenum cap, bool on)
+{
+    int & cached = cap == GL_DEPTH_TEST ? _depthTest : cap == GL_CULL_FACE ? _cullFace : _blend;
+    if (changed(this, cached, on))
+    {
+        if (on) glEnable(cap);
+        else glDisable(cap);
+    }
+}
+
+void GlState::DepthMask(bool on)
+{
+    if (changed(this, _depthMask, on)) glDepthMask(on);
+}
+
+void GlState::DepthFunc(GLenum func)
+{
+    if (changed(this, _depthFunc, func)) glDepthFunc(func);
+}
+
+void GlState::FrontFace(GLenum mode)
+{
+    if (changed(this, _frontFace, mode)) glFrontFace(mode);
+}
+
+void GlState::BlendFunc(GLenum src, GLenum dst)
+{
+    bool a = changed(this, _blendSrc, src);
+    bool b = changed(this, _blendDst, dst);
+    if (a || b)
+    {
+        glBlendFunc(src, dst);
+        for (int i=0; i<DrawBuffers; i++)
+        {
+            _bufferSrc[i] = src;
+            _bufferDst[i] = dst;
+        }
+    }
+}
+
+void GlState::BlendFunci(GLuint buffer, GLenum src, GLenum dst)
+{
+    bool a = changed(this, _bufferSrc[buffer], src);
+    bool b = changed(this, _bufferDst[buffer], dst);
+    if (a || b)
+    {
+        glBlendFunci(buffer, src, dst);
+        _blendSrc = _blendDst = Unknown;
+    }
+}
+
+void GlState::BindFramebuffer(GLuint framebuffer)
+{
+    if (changed(this, _framebuffer, framebuffer)) glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GlState::Viewport(int x, int y, int width, int height)
+{
+    _calls++;
+    if (_viewport == ivec4(x, y, width, height))
+    {
+        _skipped++;
+        return;
+    }
+    _viewport = ivec4(x, y, width, height);
+    glViewport(x, y, width, height);
+}
+
+void GlState::UseProgram(GLuint program)
+{
+    if (changed(this, _program, program)) glUseProgram(program);
+}
+
+void GlState::BindTexture(int unit, GLenum target, GLuint texture)
+{
+    _calls++;
+    if (_target[unit] == (int)target && _texture[unit] == (int)texture)
+    {
+        _skipped++;
+        return;
+    }
+    _target[unit] = target;
+    _texture[unit] = texture;
+    if (changed(this, _activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+}
+
+static bool isDepth(GLenum format)
+{
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24
+        || format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8;
+}
+
+static bool sameDesc(TargetDesc const& a, TargetDesc const& b)
+{
+    return a.format == b.format && a.width == b.width && a.height == b.height
+        && a.layers == b.layers && a.filter == b.filter && a.compare == b.compare;
+}
+
+void RenderGraph::Clear()
+{
+    _targets.clear();
+    _passes.clear();
+    _order.clear();
+}
+
+int RenderGraph::Create(const char *name, TargetDesc const& desc)
+{
+    RenderTarget t = { name, desc, false, 0, -1, -1 };
+    _targets.push_back(t);
+    return _targets.size()-1;
+}
+
+int RenderGraph::Import(const char *name, GLuint texture, TargetDesc const& desc)
+{
+    RenderTarget t = { name, desc, true, texture, -1, -1 };
+    _targets.push_back(t);
+    return _targets.size()-1;
+}
+
+int RenderGraph::AddPass(const char *name, PassState const& state, std::function<void()> run)
+{
+    RenderPass p;
+    p.name = name;
+    p.state = state;
+    p.run = run;
+    p.alive = false;
+    _passes.push_back(p);
+    return _passes.size()-1;
+}
+
+void RenderGraph::Read(int pass, int target)
+{
+    _passes[pass].reads.push_back(target);
+}
+
+void RenderGraph::Write(int pass, int target)
+{
+    _passes[pass].writes.push_back(target);
+}
+
+void RenderGraph::Compile()
+{
+    const int n = _passes.size();
+
+    // a read depends on the last pass declared before it writing the target,
+    // or failing that on the first one after
+    vector<vector<int> > producers(n);
+    for (int p=0; p<n; p++)
+    for (int t : _passes[p].reads)
+    {
+        int producer = -1;
+        for (int q=0; q<n; q++)
+        {
+            bool writes = std::find(_passes[q].writes.begin(), _passes[q].writes.end(), t) != _passes[q].writes.end();
+            if (q == p || !writes) continue;
+            if (q < p || producer < 0) producer = q;
+            if (q > p) break;
+        }
+        if (producer >= 0) producers[p].push_back(producer);
+    }
+
+    // whatever reaches an external target survives, the rest is skipped
+    vector<int> stack;
+    for (int p=0; p<n; p++)
+    for (int t : _passes[p].writes)
+    {
+        if (_targets[t].external && !_passes[p].alive)
+        {
+            _passes[p].alive = true;
+            stack.push_back(p);
+        }
+    }
+    while (stack.size())
+    {
+        int p = stack.back();
+        stack.pop_back();
+        for (int q : producers[p])
+        {
+            if (_passes[q].alive) continue;
+            _passes[q].alive = true;
+            stack.push_back(q);
+        }
+    }
+
+    // dependencies first, otherwise in the order the passes were added
+    vector<char> done(n, 0);
+    for (bool progress = true; progress; )
+    {
+        progress = false;
+        for (int p=0; p<n; p++)
+        {
+            if (done[p] || !_passes[p].alive) continue;
+            bool ready = true;
+            for (int q : producers[p]) ready &= done[q] || q == p;
+            if (!ready) continue;
+            done[p] = 1;
+            _order.push_back(p);
+            progress = true;
+            break;
+        }
+    }
+    for (int p=0; p<n; p++)
+    {
+        if (_passes[p].alive && !done[p])
+        { // a cycle, run the rest as declared
+            fprintf(stderr, "ERROR: render pass %s depends on itself.\n", _passes[p].name);
+            _order.push_back(p);
+        }
+    }
+
+    // lifetimes of the transient targets, in execution order
+    for (size_t i=0; i<_order.size(); i++)
+    {
+        RenderPass const& pass = _passes[_order[i]];
+        for (vector<int> const* list : { &pass.reads, &pass.writes })
+        for (int t : *list)
+        {
+            RenderTarget & target = _targets[t];
+            if (target.first < 0) target.first = i;
+            target.last = i;
+        }
+    }
+
+    // earliest first, a pooled texture of the same kind is taken over once
+    // its last holder is done with it
+    for (PooledTexture & pooled : _pool) pooled.busyUntil = -1;
+    vector<int> transient;
+    for (size_t t=0; t<_targets.size(); t++)
+    {
+        if (!_targets[t].external && _targets[t].first >= 0) transient.push_back(t);
+    }
+    std::sort(transient.begin(), transient.end(), [this](int a, int b) {
+        return _targets[a].first < _targets[b].first;
+    });
+    for (int t : transient)
+    {
+        RenderTarget & target = _targets[t];
+        PooledTexture *found = NULL;
+        for (PooledTexture & pooled : _pool)
+        {
+            if (pooled.busyUntil < target.first && sameDesc(pooled.desc, target.desc))
+            {
+                found = &pooled;
+                break;
+            }
+        }
+        if (!found)
+        {
+            TargetDesc const& d = target.desc;
+            PooledTexture pooled = { d, 0, -1 };
+            GLenum type = d.layers ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+            glGenTextures(1, &pooled.texture);
+            glBindTexture(type, pooled.texture);
+            if (d.layers) glTexStorage3D(type, 1, d.format, d.width, d.height, d.layers);
+            else glTexStorage2D(type, 1, d.format, d.width, d.height);
+            glTexParameteri(type, GL_TEXTURE_MIN_FILTER, d.filter);
+            glTexParameteri(type, GL_TEXTURE_MAG_FILTER, d.filter);
+            glTexParameteri(type, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(type, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (d.compare)
+            {
+                glTexParameteri(type, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+                glTexParameteri(type, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            }
+            glBindTexture(type, 0);
+            if (_state) _state->ForgetTextures();
+            _pool.push_back(pooled);
+            found = &_pool.back();
+        }
+        found->busyUntil = target.last;
+        target.texture = found->texture;
+    }
+}
+
+void RenderGraph::Execute()
+{
+    for (int p : _order)
+    {
+        RenderPass const& pass = _passes[p];
+        PassState const& s = pass.state;
+        _state->Enable(GL_DEPTH_TEST, s.depthTest);
+        _state->DepthMask(s.depthWrite);
+        _state->Enable(GL_CULL_FACE, s.cullFace);
+        _state->Enable(GL_BLEND, s.blend);
+        _state->DepthFunc(s.depthFunc);
+        _state->FrontFace(s.frontFace);
+
+        // depth first, then the colors, one framebuffer per distinct set
+        vector<GLuint> attachments(1, 0);
+        bool framebuffer = false, backbuffer = false;
+        for (int t : pass.writes)
+        {
+            RenderTarget const& target = _targets[t];
+            if (target.external && target.texture == 0) backbuffer = true;
+            if (target.desc.layers || (target.external && target.texture == 0)) continue;
+            if (isDepth(target.desc.format)) attachments[0] = target.texture;
+            else attachments.push_back(target.texture);
+            framebuffer = true;
+        }
+        if (backbuffer)
+        {
+            _state->BindFramebuffer(0);
+        }
+        else if (framebuffer)
+        {
+            GLuint & fb = _framebuffers[attachments];
+            if (!fb)
+            {
+                glGenFramebuffers(1, &fb);
+                glBindFramebuffer(GL_FRAMEBUFFER, fb);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachments[0], 0);
+                GLenum drawBuffers[8];
+                int colors = attachments.size()-1;
+                for (int i=0; i<colors; i++)
+                {
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0+i, GL_TEXTURE_2D, attachments[i+1], 0);
+                    drawBuffers[i] = GL_COLOR_ATTACHMENT0+i;
+                }
+                glDrawBuffers(colors, drawBuffers);
+                glReadBuffer(GL_NONE);
+                _state->_framebuffer = fb;
+            }
+            _state->BindFramebuffer(fb);
+        }
+        pass.run();
+    }
+}
+
+GLuint RenderGraph::Texture(int target) const
+{
+    return _targets[target].texture;
+}
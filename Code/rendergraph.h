@@ -0,0 +1,111 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+#include "common.h"
+#include <glad/glad.h>
+#include <functional>
+#include <map>
+
+/// shadow copy of the GL state the passes touch, calls that would not change
+/// anything never reach the driver
+struct GlState
+{
+    enum { Units = 32, DrawBuffers = 8, Unknown = -1 };
+    int _depthTest, _cullFace, _blend, _depthMask;
+    int _depthFunc, _frontFace, _blendSrc, _blendDst;   // unknown once the buffers differ
+    int _bufferSrc[DrawBuffers], _bufferDst[DrawBuffers];
+    int _framebuffer, _program, _activeUnit;
+    ivec4 _viewport;
+    int _target[Units], _texture[Units];
+    int _calls = 0, _skipped = 0;   // state calls, and how many never reached GL
+
+    /// forget everything, after code that goes around the cache
+    void Reset();
+
+    /// forget the active unit and the bound textures only
+    void ForgetTextures();
+
+    void Enable(GLenum cap, bool on);
+    void DepthMask(bool on);
+    void DepthFunc(GLenum func);
+    void FrontFace(GLenum mode);
+    void BlendFunc(GLenum src, GLenum dst);
+    void BlendFunci(GLuint buffer, GLenum src, GLenum dst);
+    void BindFramebuffer(GLuint framebuffer);
+    void Viewport(int x, int y, int width, int height);
+    void UseProgram(GLuint program);
+    void BindTexture(int unit, GLenum target, GLuint texture);
+};
+
+typedef struct {
+    GLenum format;
+    int width, height;
+    int layers;         // 0 for a plain 2D texture
+    GLenum filter;
+    bool compare;       // depth compare, for shadow samplers
+}TargetDesc;
+
+/// fixed function state of a pass, set through the cache before it runs
+typedef struct {
+    bool depthTest, depthWrite, cullFace, blend;
+    GLenum depthFunc, frontFace;
+}PassState;
+
+typedef struct {
+    const char *name;
+    TargetDesc desc;
+    bool external;      // owned outside the graph and kept across frames
+    GLuint texture;     // 0 for an external target is the default framebuffer
+    int first, last;    // passes using it, in execution order
+}RenderTarget;
+
+typedef struct {
+    const char *name;
+    PassState state;
+    std::function<void()> run;
+    vector<int> reads, writes;
+    bool alive;
+}RenderPass;
+
+typedef struct {
+    TargetDesc desc;
+    GLuint texture;
+    int busyUntil;      // last pass of the target holding it this frame
+}PooledTexture;
+
+/// passes declare the targets they read and write; the graph runs them in
+/// dependency order, skips those whose results nobody uses and lets
+/// transient targets with disjoint lifetimes share one texture
+struct RenderGraph
+{
+    GlState *_state = NULL;
+    vector<RenderTarget> _targets;
+    vector<RenderPass> _passes;
+    vector<int> _order;
+    vector<PooledTexture> _pool;                            // kept across frames
+    std::map<vector<GLuint>, GLuint> _framebuffers;         // per attachment set
+
+    /// drop the passes and targets of the last frame, the textures stay pooled
+    void Clear();
+
+    /// texture allocated by the graph, only valid during the frame
+    int Create(const char *name, TargetDesc const& desc);
+
+    /// texture owned by the caller, 0 for the default framebuffer
+    int Import(const char *name, GLuint texture, TargetDesc const& desc);
+
+    int AddPass(const char *name, PassState const& state, std::function<void()> run);
+
+    void Read(int pass, int target);
+    void Write(int pass, int target);
+
+    /// order, cull, then place the transient targets in the pool
+    void Compile();
+
+    /// binds the framebuffer of every pass, its 2D targets attached in the
+    /// order they were written, layered targets are left to the pass
+    void Execute();
+
+    GLuint Texture(int target) const;
+};
+
+#endif // RENDERGRAPH_H
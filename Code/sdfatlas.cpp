@@ -0,0 +1,211 @@
+#include "sdfatlas.h"
+#include <stdio.h>
+
+static const vec3 AtlasMin = vec3(-16, -4, -16);
+static const float BrickSize = 1.f;
+
+void SdfAtlas::Init()
+{
+    const int size = SlotsPerAxis*BrickTexels;
+    glGenTextures(1, &_atlas);
+    glBindTexture(GL_TEXTURE_3D, _atlas);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RG16F, size, size, size);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &_bricks);
+    glBindTexture(GL_TEXTURE_3D, _bricks);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA32F, GridX, GridY, GridZ);
+    { // no brick has a slot and every one is far until its first bake
+        vector<vec4> empty(GridSize, vec4(vec3(-1), 1e9f));
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0,0,0, GridX, GridY, GridZ, GL_RGBA, GL_FLOAT, empty.data());
+    }
+
+    glGenTextures(1, &_owners);
+    glBindTexture(GL_TEXTURE_3D, _owners);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA32F, SlotsPerAxis, SlotsPerAxis, SlotsPerAxis);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    glGenTextures(1, &_coarse);
+    glBindTexture(GL_TEXTURE_2D, _coarse);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, GridX, GridY*GridZ);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &_readback);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _readback);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GridSize * sizeof(float), NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glGenFramebuffers(1, &_framebuffer);
+
+    _slot.assign(GridSize, -1);
+    _owner.assign(SlotCount, -1);
+    _invalid.assign(GridSize, 0);
+    _dirty.assign(SlotCount, 0);
+    _distance.assign(GridSize, 1e9f);
+    _lo = ivec3(GridX, GridY, GridZ);
+    _hi = ivec3(-1);
+    _free.clear();
+    for (int i=SlotCount-1; i>=0; i--)
+    {
+        _free.push_back(i);
+    }
+    Invalidate(AtlasMin, AtlasMin + vec3(GridX, GridY, GridZ)*BrickSize);
+}
+
+void SdfAtlas::Invalidate(vec3 lo, vec3 hi)
+{
+    ivec3 a = max(ivec3(floor((lo - AtlasMin) / BrickSize)), ivec3(0));
+    ivec3 b = min(ivec3(floor((hi - AtlasMin) / BrickSize)), ivec3(GridX, GridY, GridZ)-1);
+    if (a.x > b.x || a.y > b.y || a.z > b.z) return;
+    for (int z=a.z; z<=b.z; z++)
+    for (int y=a.y; y<=b.y; y++)
+    for (int x=a.x; x<=b.x; x++)
+    {
+        _invalid[x + GridX*(y + GridY*z)] = 1;
+    }
+    _lo = min(_lo, a);
+    _hi = max(_hi, b);
+    _pending = true;
+}
+
+int SdfAtlas::Bake(GLuint coarseProg, GLuint brickProg)
+{
+    if (!_pending) return 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+
+    // the coarse texture is laid out x by (y, z) rows, the queued box spans
+    // the rows from its lowest to its highest
+    const int x0 = _fence ? _readLo.x : _lo.x;
+    const int y0 = _fence ? _readLo.y + GridY*_readLo.z : _lo.y + GridY*_lo.z;
+    const int w = (_fence ? _readHi.x : _hi.x) - x0 + 1;
+    const int h = (_fence ? _readHi.y + GridY*_readHi.z : _hi.y + GridY*_hi.z) - y0 + 1;
+    if (!_fence)
+    { // distance at the queued brick centers only, read back into the buffer
+        _readLo = _lo, _readHi = _hi;
+        _lo = ivec3(GridX, GridY, GridZ);
+        _hi = ivec3(-1);
+        for (int z=_readLo.z; z<=_readHi.z; z++)
+        for (int y=_readLo.y; y<=_readHi.y; y++)
+        for (int x=_readLo.x; x<=_readHi.x; x++)
+        {
+            char & invalid = _invalid[x + GridX*(y + GridY*z)];
+            if (invalid) invalid = 2;
+        }
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _coarse, 0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glViewport(0,0, GridX, GridY*GridZ);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x0, y0, w, h);
+        glUseProgram(coarseProg);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisable(GL_SCISSOR_TEST);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _readback);
+        glReadPixels(x0, y0, w, h, GL_RED, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return 0;
+    }
+    if (glClientWaitSync(_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+    { // not back yet, ask again next frame
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return 0;
+    }
+    glDeleteSync(_fence);
+    _fence = 0;
+    _pending = _lo.x <= _hi.x;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _readback);
+    const float *coarse = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, w*h * sizeof(float), GL_MAP_READ_BIT);
+    for (int z=_readLo.z; z<=_readHi.z; z++)
+    for (int y=_readLo.y; y<=_readHi.y; y++)
+    for (int x=_readLo.x; x<=_readHi.x; x++)
+    {
+        _distance[x + GridX*(y + GridY*z)] = coarse[(y + GridY*z - y0)*w + x - x0];
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // bricks the surface may pass through get a slot, with a two sample margin;
+    // those queued again meanwhile wait for their own readback
+    const float nearSurface = BrickSize * (.87f + 2.f/(BrickTexels-1));
+    const ivec3 size = _readHi - _readLo + 1;
+    vector<vec4> bricks;
+    int baked = 0;
+    for (int z=_readLo.z; z<=_readHi.z; z++)
+    for (int y=_readLo.y; y<=_readHi.y; y++)
+    for (int x=_readLo.x; x<=_readHi.x; x++)
+    {
+        const int i = x + GridX*(y + GridY*z);
+        if (_invalid[i] == 2)
+        {
+            _invalid[i] = 0;
+            bool needed = abs(_distance[i]) < nearSurface;
+            if (needed && _slot[i] < 0 && !_free.empty())
+            {
+                _slot[i] = _free.back();
+                _free.pop_back();
+                _owner[_slot[i]] = i;
+            }
+            else if (!needed && _slot[i] >= 0)
+            {
+                _owner[_slot[i]] = -1;
+                _free.push_back(_slot[i]);
+                _slot[i] = -1;
+            }
+            if (_slot[i] >= 0)
+            {
+                _dirty[_slot[i]] = 1;
+                baked++;
+            }
+        }
+        int s = _slot[i];
+        bricks.push_back(s < 0 ? vec4(vec3(-1), _distance[i])
+            : vec4(s % SlotsPerAxis, s / SlotsPerAxis % SlotsPerAxis, s / (SlotsPerAxis*SlotsPerAxis), _distance[i]));
+    }
+    if (_free.empty())
+    {
+        fprintf(stderr, "WARNING: sdf atlas is full\n");
+    }
+    glBindTexture(GL_TEXTURE_3D, _bricks);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, _readLo.x, _readLo.y, _readLo.z, size.x, size.y, size.z,
+                    GL_RGBA, GL_FLOAT, bricks.data());
+
+    // one pass per atlas slice, only the slices of slots holding dirty bricks,
+    // whose owners are uploaded first
+    const int texels = SlotsPerAxis*BrickTexels;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, _owners);
+    glViewport(0,0, texels, texels);
+    glUseProgram(brickProg);
+    GLint iLayer = glGetUniformLocation(brickProg, "iLayer");
+    for (int z=0; z<SlotsPerAxis; z++)
+    {
+        int first = z*SlotsPerAxis*SlotsPerAxis, dirty = 0;
+        static vec4 owners[SlotsPerAxis*SlotsPerAxis];
+        for (int s=first; s<first+SlotsPerAxis*SlotsPerAxis; s++)
+        {
+            int i = _owner[s];
+            ivec3 b = ivec3(i % GridX, i / GridX % GridY, i / (GridX*GridY));
+            owners[s-first] = vec4(AtlasMin + vec3(b)*BrickSize, i >= 0 && _dirty[s]);
+            dirty |= _dirty[s];
+            _dirty[s] = 0;
+        }
+        if (!dirty) continue;
+
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0,0,z, SlotsPerAxis, SlotsPerAxis, 1, GL_RGBA, GL_FLOAT, owners);
+        for (int k=0; k<BrickTexels; k++)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _atlas, 0, z*BrickTexels+k);
+            glProgramUniform1i(brickProg, iLayer, z*BrickTexels+k);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return baked;
+}
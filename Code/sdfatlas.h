@@ -0,0 +1,47 @@
+#ifndef SDFATLAS_H
+#define SDFATLAS_H
+#include "common.h"
+#include <glad/glad.h>
+
+// keep in sync with common.glsl
+enum {
+    GridX = 32, GridY = 8, GridZ = 32, // bricks over the atlas bounds
+    GridSize = GridX*GridY*GridZ,
+    SlotsPerAxis = 16,
+    SlotCount = SlotsPerAxis*SlotsPerAxis*SlotsPerAxis,
+    BrickTexels = 8,                   // samples per edge, shared with the neighbour
+};
+
+/// sparse brick atlas of the scene SDF, only bricks near the surface are baked
+struct SdfAtlas
+{
+    GLuint _atlas;          // RG16F distance and material, SlotsPerAxis bricks per edge
+    GLuint _bricks;         // RGBA32F per brick, atlas slot or -1 and the distance at its center
+    GLuint _owners;         // RGBA32F per slot, brick origin and whether to bake it
+    GLuint _coarse;         // R32F distance at every brick center
+    GLuint _readback;       // pixel pack buffer the coarse distances come back through
+    GLsync _fence = 0;      // while a readback is in flight
+    GLuint _framebuffer;
+
+    vector<int> _slot;      // per brick, -1 when empty
+    vector<int> _owner;     // per slot, -1 when free
+    vector<int> _free;
+    vector<char> _invalid;  // per brick, 1 queued, 2 in the readback in flight
+    vector<char> _dirty;    // per slot
+    vector<float> _distance;// per brick, at its center as last read back
+    ivec3 _lo, _hi;         // bricks queued since the last coarse pass, empty when lo > hi
+    ivec3 _readLo, _readHi; // and those of the readback in flight
+    bool _pending = false;
+
+    void Init();
+
+    /// queue the bricks overlapping a box, e.g. the old and new bounds of a moving primitive
+    void Invalidate(vec3 lo, vec3 hi);
+
+    /// refresh the queued bricks over two calls or more: the coarse pass over
+    /// their region is read back without waiting, the bricks are baked once it
+    /// has arrived. Returns how many were baked
+    int Bake(GLuint coarseProg, GLuint brickProg);
+};
+
+#endif // SDFATLAS_H
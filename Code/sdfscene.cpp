@@ -0,0 +1,85 @@
+#include "sdfscene.h"
+
+int SdfScene::Add(SdfPrimitive const& primitive)
+{
+    if (_primitives.size() >= SdfMaxPrimitives) return -1;
+    _primitives.push_back(primitive);
+    return _primitives.size()-1;
+}
+
+float SdfScene::Radius(int i) const
+{
+    SdfPrimitive const& p = _primitives[i];
+    float r = p.type == SdfSphere ? p.params.x
+            : p.type == SdfBox ? length(vec3(p.params)) + p.params.w
+            : p.params.x + p.params.y;
+    return r + p.blend; // a smooth union reshapes the field as far as its radius
+}
+
+void SdfScene::Bounds(vec3 *lo, vec3 *hi) const
+{
+    *lo = vec3(1e9);
+    *hi = vec3(-1e9);
+    for (size_t i=0; i<_primitives.size(); i++)
+    {
+        float r = Radius(i);
+        *lo = min(*lo, _primitives[i].pos - r);
+        *hi = max(*hi, _primitives[i].pos + r);
+    }
+}
+
+void SdfScene::Cull(vec3 ro, vec3 ta, float fov, vec2 res)
+{
+    vec3 cw = normalize(ta-ro);
+    vec3 cu = normalize(cross(cw, vec3(0,1,0)));
+    vec3 cv = cross(cu, cw);
+
+    const int stride = SdfMaxPrimitives+1;
+    _tilesX = (int(res.x) + SdfTile-1) / SdfTile;
+    _tilesY = (int(res.y) + SdfTile-1) / SdfTile;
+    _lists.assign((1 + _tilesX*_tilesY) * stride, 0);
+
+    for (size_t i=0; i<_primitives.size(); i++)
+    {
+        _lists[0]++;
+        _lists[i+1] = i;
+
+        vec3 d = _primitives[i].pos - ro;
+        float r = Radius(i);
+        float x = dot(d, cu), y = dot(d, cv), z = dot(d, cw);
+        if (z + r < 0.f) continue;
+
+        // a ray through uv passes by fov*(x/z, y/z), the box around the sphere
+        // projects no further than its corners
+        ivec2 a = ivec2(0), b = ivec2(_tilesX-1, _tilesY-1);
+        if (z - r > .1f)
+        {
+            vec2 lo = vec2(min((x-r)/(z-r), (x-r)/(z+r)), min((y-r)/(z-r), (y-r)/(z+r)));
+            vec2 hi = vec2(max((x+r)/(z-r), (x+r)/(z+r)), max((y+r)/(z-r), (y+r)/(z+r)));
+            lo = (lo*fov*res.y + res) * .5f;
+            hi = (hi*fov*res.y + res) * .5f;
+            if (hi.x < 0.f || hi.y < 0.f || lo.x >= res.x || lo.y >= res.y) continue;
+            a = max(ivec2(lo) / int(SdfTile), a);
+            b = min(ivec2(hi) / int(SdfTile), b);
+        }
+
+        for (int ty=a.y; ty<=b.y; ty++)
+        for (int tx=a.x; tx<=b.x; tx++)
+        {
+            short *list = &_lists[(1 + tx + ty*_tilesX) * stride];
+            list[++list[0]] = i;
+        }
+    }
+}
+
+void SdfScene::Texels(vector<vec4> & T) const
+{
+    for (SdfPrimitive const& p : _primitives)
+    {
+        T.push_back(vec4(p.pos, p.type));
+        T.push_back(vec4(p.rot[0], p.blend));
+        T.push_back(vec4(p.rot[1], p.material));
+        T.push_back(vec4(p.rot[2], 0));
+        T.push_back(p.params);
+    }
+}
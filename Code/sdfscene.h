@@ -0,0 +1,47 @@
+#ifndef SDFSCENE_H
+#define SDFSCENE_H
+#include "common.h"
+
+// keep in sync with common.glsl
+enum {
+    SdfTile = 32,           // screen tile edge in pixels
+    SdfMaxPrimitives = 256,
+    SdfTexels = 5,          // texels per primitive
+};
+
+typedef enum {
+    SdfSphere,              // params.x radius
+    SdfBox,                 // params.xyz half extents, params.w rounding
+    SdfTorus,               // params.xy major and minor radius
+}SdfType;
+
+typedef struct {
+    SdfType type;
+    mat3 rot;               // local axes in world space
+    vec3 pos;
+    vec4 params;
+    float blend;            // smooth union radius, 0 for a hard union
+    float material;
+}SdfPrimitive;
+
+/// SDF primitives of the scene and, per screen tile, the ones its rays can reach
+struct SdfScene
+{
+    vector<SdfPrimitive> _primitives;
+    vector<short> _lists;   // rows of count then indices, row 0 holds every primitive
+    int _tilesX = 0, _tilesY = 0;
+
+    int Add(SdfPrimitive const& primitive);
+
+    /// bounding radius around the position, blending included
+    float Radius(int i) const;
+
+    void Bounds(vec3 *lo, vec3 *hi) const;
+
+    void Cull(vec3 ro, vec3 ta, float fov, vec2 res);
+
+    /// primitive texels, SdfTexels RGBA per primitive
+    void Texels(vector<vec4> & T) const;
+};
+
+#endif // SDFSCENE_H
@@ -0,0 +1,61 @@
+#include "shadow.h"
+
+static mat3 lightBasis(vec3 sunDir)
+{
+    vec3 lw = -sunDir;
+    vec3 lu = normalize(cross(lw, vec3(0,1,0)));
+    vec3 lv = cross(lu, lw);
+    return mat3(lu, lv, lw);
+}
+
+void FitCascades(vec3 ro, vec3 ta, float fov, vec2 res, vec3 sunDir, float shadowFar, Cascade out[])
+{
+    const float n = .1f, lambda = .75f, casters = 20.f;
+    vec3 cw = normalize(ta-ro);
+    mat3 light = lightBasis(sunDir);
+
+    // corner of the frustum at unit distance along the view axis
+    float ar = res.x / res.y;
+    float k2 = (ar*ar + 1.f) / (fov*fov);
+
+    float near = n;
+    for (int i=0; i<CascadeCount; i++)
+    {
+        // practical split, between logarithmic and uniform
+        float s = (i+1.f) / CascadeCount;
+        float far = mix(n + (shadowFar-n)*s, n * pow(shadowFar/n, s), lambda);
+
+        // bounding sphere of the slice, on the view axis
+        float c = min(far, (near+far) * .5f * (1.f + k2));
+        float r = sqrt((far-c)*(far-c) + far*far*k2);
+
+        vec3 center = (ro + cw * c) * light;
+        float texel = 2.f*r / CascadeSize;
+        center.x = floor(center.x / texel) * texel;
+        center.y = floor(center.y / texel) * texel;
+        // along the light in coarse steps, the depth range grown by one, so
+        // the static cache is not redrawn for every small move of the camera
+        const float step = casters * .25f;
+        center.z = floor(center.z / step) * step;
+
+        Cascade & cascade = out[i];
+        cascade.center = center;
+        cascade.radius = r;
+        cascade.depth = r + casters + step;
+        cascade.split = far;
+        cascade.viewProj = transpose(mat4(
+            vec4(light[0] / r, -center.x / r),
+            vec4(light[1] / r, -center.y / r),
+            vec4(light[2] / cascade.depth, -center.z / cascade.depth),
+            vec4(0, 0, 0, 1)));
+        near = far;
+    }
+}
+
+bool CascadeOverlaps(Cascade const& c, vec3 sunDir, vec3 center, float radius)
+{
+    vec3 p = center * lightBasis(sunDir) - c.center;
+    return abs(p.x) < c.radius + radius
+        && abs(p.y) < c.radius + radius
+        && abs(p.z) < c.depth + radius;
+}
@@ -0,0 +1,26 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+#include "common.h"
+
+// keep in sync with the SHADOW block and RES_W in main.cpp
+enum {
+    CascadeCount = 4,
+    CascadeSize = 1024,     // texels per edge of every layer
+};
+
+typedef struct {
+    mat4 viewProj;          // world to light clip space
+    vec3 center;            // snapped to texels, in steps along the light
+    float radius;           // half extent of the square
+    float depth;            // half extent along the light
+    float split;            // far end along the view axis
+}Cascade;
+
+/// fits the cascades to slices of the view frustum, each bounded by a sphere
+/// so its size never changes, and snapped to whole texels so it never shimmers
+void FitCascades(vec3 ro, vec3 ta, float fov, vec2 res, vec3 sunDir, float shadowFar, Cascade out[]);
+
+/// whether a sphere may cast a shadow into the cascade
+bool CascadeOverlaps(Cascade const& c, vec3 sunDir, vec3 center, float radius);
+
+#endif // SHADOW_H
@@ -1,31 +1,82 @@
 #version 300 es
 precision mediump float;
 
-mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
-{
-    vec3 cw = normalize(ta-ro);
-    vec3 cp = vec3(sin(cr), cos(cr), 0.0);
-    vec3 cu = normalize(cross(cw, cp));
-    vec3 cv = cross(cu, cw);
-    return mat3(cu, cv, cw);
-}
+layout (std140) uniform SHADOW {
+    mat4 iCascade[4];   // world to light clip space, per cascade
+    vec4 iSplits;       // far end of every cascade along the view axis
+};
+uniform int iLayer;
 
-vec4 World2Clip(vec3 pos, vec3 rd)
+vec4 World2Clip(vec3 pos)
 {
-    const float ie = 1./5.;
-    mat3 ca = setCamera(vec3(0), rd, 0.);
-    return vec4(ie,ie,-ie,1.) * vec4(pos*ca, 1.);
+    return iCascade[iLayer] * vec4(pos, 1);
 }
 
 #ifdef _VS
-layout (location = 0) in vec3 a_Vertex;
-layout (location = 4) in mat3 a_Rotation;
-layout (location = 7) in vec3 a_Position;
+layout (location = 0) in highp vec4 a_Packed;   // 16 bit grid, mesh in w
+
+#ifdef _PULL
+// every command of the cascade in one call, as in base.glsl; the cascades'
+// instances are the packed ones, seven words each
+layout (std430, binding = 0) readonly buffer DRAWS { uvec2 iDraw[]; };
+layout (std430, binding = 3) readonly buffer PACKED_INSTANCES { uint iPacked[]; };
+layout (std430, binding = 4) readonly buffer DRAW_IDS { uint iDrawId[]; };
+uniform int iFirstDraw;
+
+layout (location = 2) in uvec4 a_Joints;
+layout (location = 3) in vec4 a_Weights;
 void main()
 {
-    vec3 pos = a_Vertex.xyz * a_Rotation + a_Position;
-    gl_Position = World2Clip(pos, normalize(vec3(1,2,3)));
+    uvec2 draw = iDraw[iFirstDraw + gl_DrawID];
+    int i = int(draw.y) + gl_InstanceID;
+    vec3 pos = meshVertex(a_Packed), nor = vec3(0);
+    if (draw.x == 0u)
+    { // rigid
+        int w = i*7;
+        vec4 q; vec3 sca;
+        unpackPacked(uvec4(iPacked[w], iPacked[w+1], iPacked[w+2], iPacked[w+3]), q, sca);
+        pos = qrot(q, pos * sca) + uintBitsToFloat(uvec3(iPacked[w+4], iPacked[w+5], iPacked[w+6]));
+    }
+    else if (draw.x == 1u)
+    { // skinned
+        skin(int(iDrawId[i]), a_Joints, a_Weights, pos, nor);
+    }
+    else
+    { // joints
+        jointBone(int(iDrawId[i]), pos, vec3(0,0,1), pos, nor);
+    }
+    gl_Position = World2Clip(pos);
 }
+#elif defined(_SKIN)
+layout (location = 2) in uvec4 a_Joints;
+layout (location = 3) in vec4 a_Weights;
+layout (location = 9) in uint a_DrawId;
+void main()
+{
+    vec3 pos = meshVertex(a_Packed), nor = vec3(0);
+    skin(int(a_DrawId), a_Joints, a_Weights, pos, nor);
+    gl_Position = World2Clip(pos);
+}
+#elif defined(_JOINTS)
+layout (location = 9) in uint a_DrawId;
+void main()
+{
+    vec3 pos, nor;
+    jointBone(int(a_DrawId), meshVertex(a_Packed), vec3(0,0,1), pos, nor);
+    gl_Position = World2Clip(pos);
+}
+#else
+// the cascades draw packed instances, a quaternion, then the scale as halves
+layout (location = 14) in highp uvec4 a_Instance;
+layout (location = 15) in vec3 a_Position;
+void main()
+{
+    vec4 q; vec3 sca;
+    unpackPacked(a_Instance, q, sca);
+    vec3 pos = qrot(q, meshVertex(a_Packed) * sca) + a_Position;
+    gl_Position = World2Clip(pos);
+}
+#endif
 
 #else
 void main(void)
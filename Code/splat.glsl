@@ -5,6 +5,16 @@ layout (std140) uniform INPUT {
     vec2 iResolution; float iTime, _pad1;
     vec3 _ro; float _fov;
     vec3 _ta; float _pad2;
+    vec3 _pro; float _pad3; // last frame's camera
+    vec3 _pta; float _pad4;
+};
+
+// keep in sync with module.cpp
+const int MaxEmitters = 64;
+layout (std140) uniform EMITTERS {
+    int iEmitters;
+    float iDelta;                   // seconds since the last frame
+    vec4 iEmitter[MaxEmitters*3];
 };
 
 mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
@@ -16,13 +26,24 @@ mat3 setCamera(in vec3 ro, in vec3 ta, float cr)
     return mat3(cu, cv, cw);
 }
 
-mat4 getProjectionMatrix()
+// sub pixel offset of this frame, in pixels
+uniform vec2 iJitter;
+
+mat4 getProjectionMatrix(vec2 jitter)
 {
+    float fov = 1.2;
     float n = 0.1, f = 1000.0;
     float p1 = (f+n)/(f-n);
     float p2 = -2.0*f*n/(f-n);
     float ar = iResolution.x/iResolution.y;
-    return mat4(_fov/ar, 0,0,0,0, _fov, 0,0,0,0, p1,1,0,0,p2,0);
+    vec2 j = 2.*jitter/iResolution.xy;
+    return mat4(fov/ar, 0,0,0,0, fov, 0,0,j.x,j.y, p1,1,0,0,p2,0);
+}
+
+vec4 World2Clip(vec3 pos, vec3 ro, vec3 ta, vec2 jitter)
+{
+    mat3 ca = setCamera(ro, ta, 0.);
+    return getProjectionMatrix(jitter) * vec4((pos-ro)*ca, 1.);
 }
 
 #ifdef _VS
@@ -32,32 +53,67 @@ mat4 getProjectionMatrix()
 #endif
 
 _varying vec2 UV;
+flat _varying int vId;
+_varying highp vec4 vCurr;
+_varying highp vec4 vPrev;
+_varying float vDepth;
 
 #ifdef _VS
-layout (location = 0) in vec3 a_Vertex;
-layout (location = 1) in vec3 a_Normal;
+// a particle per instance, written by particle.glsl
+layout (location = 0) in highp vec4 aPosition;  // radius in w
+layout (location = 1) in highp vec4 aVelocity;  // seconds left in w
 void main()
 {
+    vId = gl_InstanceID;
     UV = vec2(gl_VertexID&1, gl_VertexID/2) *2.-1.;
-    vec3 pos = vec3(UV, 0);
-
-    float t = iTime*5.;
-    float c = cos(t), s = sin(t);
-    pos.xy *= mat2(c,s,-s,c);
-    pos.y += c + 1.;
-    pos *= .2;
+    if (aVelocity.w <= 0.)
+    { // dead, off the screen
+        gl_Position = vec4(2, 2, 2, 1);
+        return;
+    }
 
+    // a camera facing quad, shrinking away in its last moments
     mat3 ca = setCamera(_ro, _ta, 0.);
-    gl_Position = getProjectionMatrix() * vec4(pos - _ro*ca, 1);
+    float radius = aPosition.w * min(1., aVelocity.w * 4.);
+    vec3 offset = (ca[0]*UV.x + ca[1]*UV.y) * radius;
+    vec3 pos = aPosition.xyz + offset;
+    gl_Position = World2Clip(pos, _ro, _ta, iJitter);
+    vCurr = World2Clip(pos, _ro, _ta, vec2(0));
+    vPrev = World2Clip(pos - aVelocity.xyz * iDelta, _pro, _pta, vec2(0));
+    vDepth = dot(pos - _ro, ca[2]);
 }
 #else
-layout (location = 0) out vec4 fragColor;
-layout (location = 1) out vec4 id;
+// the material in the object id, next to those of base.glsl
+const uint Material = 3u;
+
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 s = vec2(n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1.);
+    return n.z >= 0. ? n.xy : (1. - abs(n.yx)) * s;
+}
+
+// soft discs into the order independent targets of draw.glsl when translucent
+#ifndef _TRANSLUCENT
+layout (location = 0) out vec4 fragNormal;
+layout (location = 1) out uint fragId;
+layout (location = 2) out vec4 fragMotion;
+#endif
 void main()
 {
-    float d = smoothstep(0., -.1, length(UV)-1.);
-    vec3 col = vec3(1,0,1);
-    fragColor = vec4(col, d);
-    id = vec4(d);
+    float r2 = dot(UV, UV);
+    if (r2 > 1.) discard;
+
+    // a sphere seen from the camera
+    mat3 ca = setCamera(_ro, _ta, 0.);
+    vec3 nor = ca * vec3(UV, -sqrt(1. - r2));
+#ifdef _TRANSLUCENT
+    float sun = dot(nor, normalize(vec3(1,2,3))) * .4 + .6;
+    writeTranslucent(vec3(.8, .65, .45) * sun, (1. - r2) * .6, vDepth);
+#else
+    fragNormal = vec4(octEncode(nor) * .5 + .5, 0, 1);
+    fragId = (uint(vId) & 0xffffu) | (Material << 16);
+    fragMotion = vec4((vCurr.xy/vCurr.w - vPrev.xy/vPrev.w) * .5, 0, 1);
+#endif
 }
 #endif
@@ -0,0 +1,60 @@
+#version 300 es
+precision mediump float;
+
+// resolves the jittered lighting against the reprojected history, at the
+// window size; the frame fills the lower left iScale of its textures
+uniform sampler2D iChannel0;        // lighting
+uniform highp sampler2D iChannel1;  // motion in screen uv
+uniform sampler2D iChannel2;        // history
+uniform vec2 iScale;
+uniform float iBlend;               // weight of this frame, 1 drops the history
+#ifdef _CHECKER
+uniform int iParity;                // the pixels lit this frame
+#endif
+out vec4 fragColor;
+
+bool lit(ivec2 p)
+{
+#ifdef _CHECKER
+    return ((p.x + p.y) & 1) == iParity;
+#else
+    return true;
+#endif
+}
+
+void main()
+{
+    vec2 size = vec2(textureSize(iChannel2, 0));
+    vec2 uv = gl_FragCoord.xy / size;
+    ivec2 last = ivec2(size * iScale) - 1;
+    ivec2 pixel = min(ivec2(uv * size * iScale), last);
+
+    // what this frame shaded around the pixel bounds what the history may hold
+    vec3 lo = vec3(1e4), hi = vec3(0), sum = vec3(0);
+    float n = 0.;
+    for (int y=-1; y<=1; y++)
+    for (int x=-1; x<=1; x++)
+    {
+        ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), last);
+        if (!lit(p)) continue;
+        vec3 c = texelFetch(iChannel0, p, 0).rgb;
+        lo = min(lo, c);
+        hi = max(hi, c);
+        sum += c;
+        n++;
+    }
+
+#ifdef _CHECKER
+    // a pixel left out this frame borrows from its lit neighbours
+    ivec2 src = lit(pixel) ? pixel : ivec2(pixel.x == last.x ? pixel.x-1 : pixel.x+1, pixel.y);
+    vec3 cur = lit(pixel) ? texelFetch(iChannel0, pixel, 0).rgb : sum / n;
+#else
+    ivec2 src = pixel;
+    vec3 cur = texture(iChannel0, min(uv * iScale, iScale - .5/size)).rgb;
+#endif
+    vec2 prev = uv - texelFetch(iChannel1, src, 0).xy;
+
+    vec3 his = clamp(texture(iChannel2, prev).rgb, lo, hi);
+    float a = prev == clamp(prev, 0., 1.) ? iBlend : 1.;
+    fragColor = vec4(mix(his, cur, a), 1);
+}
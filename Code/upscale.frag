@@ -0,0 +1,14 @@
+#version 300 es
+precision mediump float;
+
+// the frame fills the lower left iScale of the texture, which has the window size
+uniform sampler2D iChannel0;
+uniform vec2 iScale;
+out vec4 fragColor;
+void main()
+{
+    vec2 size = vec2(textureSize(iChannel0, 0));
+    vec2 uv = gl_FragCoord.xy / size * iScale;
+    uv = min(uv, iScale - .5/size);
+    fragColor = texture(iChannel0, uv);
+}